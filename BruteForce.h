@@ -0,0 +1,211 @@
+/*
+ * BruteForce.h
+ *
+ *  Search kernels: the brute force inner loop, compiled once per PRNG
+ *  against its inline kernel class so seed()/random() are plain function
+ *  calls the compiler can inline, rather than two virtual calls per step.
+ *
+ *  The search runs in two stages. A filter kernel only checks whether the
+ *  first observed value turns up early enough in a seed's outputs for the
+ *  seed to reach the minimum confidence, which is a single compare per
+ *  output and vectorizes across seeds. The few seeds that get through are
+ *  then verified one at a time with the full greedy match.
+ */
+
+#ifndef BRUTEFORCE_H_
+#define BRUTEFORCE_H_
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+/* A seed, which of the searched PRNGs it belongs to, and its quality of fit */
+struct Seed
+{
+    unsigned int engine;  // Index into the list of PRNGs being searched
+    uint32_t value;
+    double confidence;
+    uint32_t offset;      // Where in the seed's outputs the first observed value matched
+};
+
+/* A run of seeds to test against a single PRNG */
+struct SearchChunk
+{
+    const uint32_t *observed;
+    uint32_t observedSize;
+    uint32_t depth;
+    double minimumConfidence;
+    unsigned int engine;
+    uint64_t firstSeed;  // Inclusive
+    uint64_t lastSeed;   // Inclusive
+    Seed *best;          // If set, kept as the best fit seen whatever minimumConfidence is
+};
+
+/* Returns true if a seed in the chunk matched every observed value */
+typedef bool (*SearchKernel)(const SearchChunk&, std::vector<Seed> *);
+
+/* Appends the seeds whose first chunk.depth outputs include observed[0] */
+typedef void (*FilterKernel)(const SearchChunk&, std::vector<uint32_t> *);
+
+/* Outputs generated per fill() call, small enough to stay in L1 */
+static const uint32_t KERNEL_BLOCK_SIZE = 256;
+
+/*
+    How deep the filter has to look. A seed reaches minimumConfidence only by
+    matching some number of observed values in order, and the first of those
+    has to come early enough to leave room for the rest within depth.
+*/
+inline uint32_t FilterDepth(uint32_t depth, uint32_t observedSize, double minimumConfidence)
+{
+    uint32_t required = 1;
+    while (required < observedSize && ((double) required / (double) observedSize) * 100.0 < minimumConfidence)
+    {
+        required++;
+    }
+    return (required <= depth) ? depth - required + 1 : 0;
+}
+
+/* The verifier: the full greedy match of every observed value, and its confidence */
+template<typename Engine> bool BruteForce(const SearchChunk& chunk, std::vector<Seed> *answers)
+{
+    Engine generator;
+    uint32_t block[KERNEL_BLOCK_SIZE];
+    bool isWinner = false;
+    for (uint64_t seedIndex = chunk.firstSeed; seedIndex <= chunk.lastSeed; ++seedIndex)
+    {
+        generator.seed((uint32_t) seedIndex);
+
+        uint32_t matchesFound = 0;
+        uint32_t firstMatch = 0;
+        for (uint32_t offset = 0; offset < chunk.depth && matchesFound < chunk.observedSize; offset += KERNEL_BLOCK_SIZE)
+        {
+            uint32_t count = std::min(KERNEL_BLOCK_SIZE, chunk.depth - offset);
+            generator.fill(block, count);
+            for (uint32_t index = 0; index < count; index++)
+            {
+                if (chunk.observed[matchesFound] == block[index])
+                {
+                    if (matchesFound == 0)
+                    {
+                        firstMatch = offset + index;
+                    }
+                    matchesFound++;
+                    if (matchesFound == chunk.observedSize)
+                    {
+                        break;  // This seed is a winner if we get to the end
+                    }
+                }
+            }
+        }
+
+        double confidence = ((double) matchesFound / (double) chunk.observedSize) * 100.0;
+        Seed seed = {chunk.engine, (uint32_t) seedIndex, confidence, firstMatch};
+        if (chunk.minimumConfidence <= confidence)
+        {
+            answers->push_back(seed);
+        }
+        if (chunk.best != NULL && chunk.best->confidence < confidence)
+        {
+            *chunk.best = seed;
+        }
+        if (matchesFound == chunk.observedSize)
+            isWinner = true;  // We found the correct seed
+    }
+    return isWinner;
+}
+
+template<typename Engine> void Filter(const SearchChunk& chunk, std::vector<uint32_t> *survivors)
+{
+    Engine generator;
+    uint32_t block[KERNEL_BLOCK_SIZE];
+    const uint32_t firstObserved = chunk.observed[0];
+    for (uint64_t seedIndex = chunk.firstSeed; seedIndex <= chunk.lastSeed; ++seedIndex)
+    {
+        generator.seed((uint32_t) seedIndex);
+
+        bool isHit = false;
+        for (uint32_t offset = 0; offset < chunk.depth && !isHit; offset += KERNEL_BLOCK_SIZE)
+        {
+            uint32_t count = std::min(KERNEL_BLOCK_SIZE, chunk.depth - offset);
+            generator.fill(block, count);
+            for (uint32_t index = 0; index < count; index++)
+            {
+                isHit |= (firstObserved == block[index]);
+            }
+        }
+        if (isHit)
+        {
+            survivors->push_back((uint32_t) seedIndex);
+        }
+    }
+}
+
+/*
+    Same filter, but WIDTH seeds at a time through a lane engine, so each
+    output is a broadcast compare across lanes. Always inlined, so that each
+    target-specific wrapper below gets its own copy vectorized for its
+    instruction set.
+*/
+template<typename Lanes> inline __attribute__((always_inline))
+void FilterLanes(const SearchChunk& chunk, std::vector<uint32_t> *survivors)
+{
+    const unsigned int WIDTH = Lanes::WIDTH;
+    Lanes generator;
+    uint32_t seeds[WIDTH];
+    uint32_t outputs[WIDTH];
+    uint32_t hits[WIDTH];
+    const uint32_t firstObserved = chunk.observed[0];
+
+    for (uint64_t firstSeed = chunk.firstSeed; firstSeed <= chunk.lastSeed; firstSeed += WIDTH)
+    {
+        /* A short last batch just repeats its final seed in the spare lanes */
+        unsigned int count = (unsigned int) std::min((uint64_t) WIDTH, chunk.lastSeed - firstSeed + 1);
+        for (unsigned int lane = 0; lane < WIDTH; ++lane)
+        {
+            seeds[lane] = (uint32_t) (firstSeed + std::min(lane, count - 1));
+            hits[lane] = 0;
+        }
+        generator.seed(seeds);
+
+        for (uint32_t index = 0; index < chunk.depth; index++)
+        {
+            generator.random(outputs);
+            for (unsigned int lane = 0; lane < WIDTH; ++lane)
+            {
+                hits[lane] |= (firstObserved == outputs[lane]);
+            }
+        }
+
+        for (unsigned int lane = 0; lane < count; ++lane)
+        {
+            if (hits[lane])
+            {
+                survivors->push_back(seeds[lane]);
+            }
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+template<typename Lanes> __attribute__((target("sse4.2")))
+void FilterSse4(const SearchChunk& chunk, std::vector<uint32_t> *survivors)
+{
+    FilterLanes<Lanes>(chunk, survivors);
+}
+
+template<typename Lanes> __attribute__((target("avx2")))
+void FilterAvx2(const SearchChunk& chunk, std::vector<uint32_t> *survivors)
+{
+    FilterLanes<Lanes>(chunk, survivors);
+}
+
+template<typename Lanes> __attribute__((target("avx512f,avx512bw,avx512vl,prefer-vector-width=512")))
+void FilterAvx512(const SearchChunk& chunk, std::vector<uint32_t> *survivors)
+{
+    FilterLanes<Lanes>(chunk, survivors);
+}
+
+#endif
+
+#endif /* BRUTEFORCE_H_ */
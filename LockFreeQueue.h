@@ -0,0 +1,116 @@
+/*
+ * LockFreeQueue.h
+ *
+ *  Bounded multi-producer, multi-consumer queue after Dmitry Vyukov's design.
+ *  Every cell carries a sequence number saying whether it is ready to be
+ *  written or read, so producers and consumers only ever contend on a single
+ *  compare-and-swap of the tail or head, and nobody takes a lock.
+ */
+
+#ifndef LOCKFREEQUEUE_H_
+#define LOCKFREEQUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+template<typename T> class LockFreeQueue
+{
+public:
+    /* Capacity is rounded up to a power of two */
+    explicit LockFreeQueue(size_t capacity) : m_cells(roundUp(capacity))
+    {
+        for (size_t index = 0; index < m_cells.size(); ++index)
+        {
+            m_cells[index].sequence.store(index, std::memory_order_relaxed);
+        }
+        m_mask = m_cells.size() - 1;
+        m_tail.store(0, std::memory_order_relaxed);
+        m_head.store(0, std::memory_order_relaxed);
+    }
+
+    /* False if the queue is full */
+    bool push(const T& value)
+    {
+        size_t position = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[position & m_mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+            if (difference == 0)
+            {
+                if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /* False if the queue is empty */
+    bool pop(T *value)
+    {
+        size_t position = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[position & m_mask];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t difference = (intptr_t) sequence - (intptr_t) (position + 1);
+            if (difference == 0)
+            {
+                if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    *value = cell.value;
+                    cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    static size_t roundUp(size_t capacity)
+    {
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::vector<Cell> m_cells;
+    size_t m_mask;
+
+    /* Producers and consumers each get their own cache line */
+    alignas(64) std::atomic<size_t> m_tail;
+    alignas(64) std::atomic<size_t> m_head;
+};
+
+#endif /* LOCKFREEQUEUE_H_ */
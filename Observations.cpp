@@ -0,0 +1,399 @@
+/*
+ * Observations.cpp
+ *
+ *  The -i loader: a mapped file, a line count for the allocation, then one
+ *  pass that scans every value in place. Pipes and stdin are parsed a chunk
+ *  at a time as the data comes in.
+ */
+
+#include "Observations.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <sstream>
+
+/* Characters of a bad value quoted back in an error, at most */
+static const size_t QUOTE_LENGTH = 24;
+
+/* Bytes read at a time from pipes and anything else that can't be mapped */
+static const size_t READ_SIZE = 1 << 16;
+
+enum ScanResult
+{
+    SCAN_OK,
+    SCAN_INVALID,
+    SCAN_OUT_OF_RANGE
+};
+
+/* Eight ASCII digits as a number, false if any of them isn't a digit */
+static inline bool ScanEightDigits(const char *text, uint64_t *value)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    uint64_t chunk;
+    memcpy(&chunk, text, sizeof(chunk));
+
+    /* A digit's high nibble is 3, and adding 6 doesn't carry out of its low one */
+    if ((chunk & 0xF0F0F0F0F0F0F0F0ULL) != 0x3030303030303030ULL ||
+        ((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) != 0x3030303030303030ULL)
+    {
+        return false;
+    }
+
+    /* The first digit is the lowest byte: combine neighbours into pairs, then fours, then all eight */
+    chunk -= 0x3030303030303030ULL;
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFULL;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFULL;
+    *value = (chunk * 10000 + (chunk >> 32)) & 0xFFFFFFFFULL;
+    return true;
+#else
+    uint64_t total = 0;
+    for (unsigned int index = 0; index < 8; ++index)
+    {
+        if (text[index] < '0' || '9' < text[index])
+        {
+            return false;
+        }
+        total = total * 10 + (text[index] - '0');
+    }
+    *value = total;
+    return true;
+#endif
+}
+
+static inline int HexDigit(char digit)
+{
+    if ('0' <= digit && digit <= '9')
+        return digit - '0';
+    if ('a' <= (digit | 0x20) && (digit | 0x20) <= 'f')
+        return (digit | 0x20) - 'a' + 10;
+    return -1;
+}
+
+/* A decimal or 0x hex number at *text, which is left just past its last digit */
+static ScanResult ScanNumber(const char **text, const char *end, uint32_t *value)
+{
+    const char *digits = *text;
+    uint64_t total = 0;
+    bool isOutOfRange = false;
+    if (2 < end - digits && digits[0] == '0' && (digits[1] | 0x20) == 'x' && 0 <= HexDigit(digits[2]))
+    {
+        int digit;
+        for (digits += 2; digits < end && 0 <= (digit = HexDigit(*digits)); ++digits)
+        {
+            total = (total << 4) | digit;
+            isOutOfRange = isOutOfRange || (UINT32_MAX < total);
+            total &= UINT32_MAX;
+        }
+    }
+    else
+    {
+        if (digits == end || *digits < '0' || '9' < *digits)
+        {
+            return SCAN_INVALID;
+        }
+        uint64_t eight;
+        while (8 <= end - digits && !isOutOfRange && ScanEightDigits(digits, &eight))
+        {
+            total = total * 100000000ULL + eight;
+            isOutOfRange = (UINT32_MAX < total);
+            digits += 8;
+        }
+        for (; digits < end && '0' <= *digits && *digits <= '9'; ++digits)
+        {
+            if (!isOutOfRange)
+            {
+                total = total * 10 + (*digits - '0');
+                isOutOfRange = (UINT32_MAX < total);
+            }
+        }
+    }
+    *text = digits;
+    *value = (uint32_t) total;
+    return isOutOfRange ? SCAN_OUT_OF_RANGE : SCAN_OK;
+}
+
+static inline bool IsBlank(char character)
+{
+    return character == ' ' || character == '\t' || character == '\r';
+}
+
+/* A bad value, cut short if it's long, for an error message */
+static std::string Quote(const char *begin, const char *end)
+{
+    std::string quoted(begin, std::min((size_t) (end - begin), QUOTE_LENGTH));
+    return (QUOTE_LENGTH < (size_t) (end - begin)) ? quoted + "..." : quoted;
+}
+
+ObservationLoader::ObservationLoader(const InputFormat& format) : m_format(format), m_line(0) {}
+
+bool ObservationLoader::parseFormat(const std::string& text, InputFormat *format)
+{
+    if (text == "text" || text == "binary")
+    {
+        format->column = 0;
+        format->isBinary = (text == "binary");
+        return true;
+    }
+    if (text.compare(0, 4, "csv:") == 0 && 4 < text.size())
+    {
+        char *end = NULL;
+        unsigned long column = strtoul(text.c_str() + 4, &end, 10);
+        if (*end == '\0' && 0 < column && column <= UINT32_MAX)
+        {
+            format->column = column;
+            format->isBinary = false;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ObservationLoader::load(const std::string& path, std::vector<uint32_t> *values)
+{
+    m_error.clear();
+    m_line = 0;
+    bool isStdin = (path == "-");
+    int file = isStdin ? STDIN_FILENO : open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        m_error = strerror(errno);
+        return false;
+    }
+
+    bool isLoaded;
+    struct stat status;
+    if (fstat(file, &status) == 0 && S_ISREG(status.st_mode) && 0 < status.st_size)
+    {
+        isLoaded = loadMapped(file, status.st_size, values);
+    }
+    else
+    {
+        isLoaded = loadStream(file, values);
+    }
+    if (!isStdin)
+    {
+        close(file);
+    }
+    return isLoaded;
+}
+
+/* A whole regular file at once */
+bool ObservationLoader::loadMapped(int file, size_t size, std::vector<uint32_t> *values)
+{
+    void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (mapping == MAP_FAILED)
+    {
+        return loadStream(file, values);  // Some special files are regular but can't be mapped
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    const char *text = (const char*) mapping;
+    bool isLoaded = m_format.isBinary ? parseBinary(text, text + size, values) : parse(text, text + size, values);
+    if (isLoaded && m_format.isBinary && size % sizeof(uint32_t) != 0)
+    {
+        isLoaded = failPartial(size % sizeof(uint32_t));
+    }
+    munmap(mapping, size);
+    return isLoaded;
+}
+
+/*
+    Pipes, stdin and the like, a chunk at a time as the data arrives: every
+    complete line (or value) in a chunk is parsed straight away, and only a
+    partial one is held over for the next chunk.
+*/
+bool ObservationLoader::loadStream(int file, std::vector<uint32_t> *values)
+{
+    std::vector<char> buffer(READ_SIZE);
+    std::string pending;
+    for (;;)
+    {
+        ssize_t count = read(file, &buffer[0], buffer.size());
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+        {
+            m_error = strerror(errno);
+            return false;
+        }
+        if (count == 0)
+            break;
+        pending.append(&buffer[0], count);
+
+        size_t complete = 0;
+        if (m_format.isBinary)
+        {
+            complete = pending.size() - pending.size() % sizeof(uint32_t);
+        }
+        else
+        {
+            size_t newline = pending.rfind('\n');
+            complete = (newline == std::string::npos) ? 0 : newline + 1;
+        }
+        const char *text = pending.data();
+        if (!(m_format.isBinary ? parseBinary(text, text + complete, values) : parse(text, text + complete, values)))
+        {
+            return false;
+        }
+        pending.erase(0, complete);
+    }
+
+    if (m_format.isBinary)
+    {
+        return pending.empty() || failPartial(pending.size());
+    }
+    return parse(pending.data(), pending.data() + pending.size(), values);  // A last line with no newline
+}
+
+const std::string& ObservationLoader::error() const
+{
+    return m_error;
+}
+
+/* Room for count more values: exactly, for a whole file, or at least doubling, a chunk of a stream at a time */
+static void Reserve(std::vector<uint32_t> *values, size_t count)
+{
+    if (values->capacity() < values->size() + count)
+    {
+        values->reserve(std::max(values->size() + count, values->capacity() * 2));
+    }
+}
+
+bool ObservationLoader::parse(const char *begin, const char *end, std::vector<uint32_t> *values)
+{
+    if (m_line == 0 && 3 <= end - begin && memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+    {
+        begin += 3;  // A UTF-8 byte order mark
+    }
+
+    /* At most one value per line, so a whole file takes a single allocation */
+    uint64_t lines = 1;
+    for (const char *newline = begin; (newline = (const char*) memchr(newline, '\n', end - newline)) != NULL; ++newline)
+    {
+        lines++;
+    }
+    Reserve(values, lines);
+
+    /* One pass: each value is scanned where it lies, and only a bad one is looked at twice */
+    const char *text = begin;
+    uint64_t line = m_line + 1;
+    for (; text < end; ++line)
+    {
+        while (text < end && IsBlank(*text))
+        {
+            text++;
+        }
+        if (text == end)
+        {
+            break;
+        }
+        if (*text == '\n')
+        {
+            text++;
+            continue;  // A blank line
+        }
+        for (unsigned int column = 1; column < m_format.column; ++column)
+        {
+            while (text < end && *text != ',' && *text != '\n')
+            {
+                text++;
+            }
+            if (text == end || *text == '\n')
+            {
+                std::ostringstream message;
+                message << "there is no column " << m_format.column;
+                return fail(line, message.str());
+            }
+            text++;
+        }
+        while (text < end && IsBlank(*text))
+        {
+            text++;
+        }
+
+        const char *field = text;
+        uint32_t value;
+        ScanResult result = ScanNumber(&text, end, &value);
+        while (text < end && IsBlank(*text))
+        {
+            text++;
+        }
+        bool isFieldEnd = (text == end || *text == '\n' || (m_format.column != 0 && *text == ','));
+        if (result != SCAN_OK || !isFieldEnd)
+        {
+            const char *fieldEnd = field;
+            while (fieldEnd < end && *fieldEnd != '\n' && (m_format.column == 0 || *fieldEnd != ','))
+            {
+                fieldEnd++;
+            }
+            while (field < fieldEnd && IsBlank(fieldEnd[-1]))
+            {
+                fieldEnd--;
+            }
+            if (isFieldEnd && result == SCAN_OUT_OF_RANGE)
+            {
+                return fail(line, "\"" + Quote(field, fieldEnd) + "\" does not fit in 32 bits");
+            }
+            if (m_format.column == 0 || line != 1)
+            {
+                if (field == fieldEnd)
+                {
+                    return fail(line, "the value is empty");
+                }
+                return fail(line, "\"" + Quote(field, fieldEnd) + "\" is not a decimal or 0x hex number");
+            }
+            text = fieldEnd;  // A CSV header, skipped with the rest of its line
+        }
+        else
+        {
+            values->push_back(value);
+        }
+
+        if (text < end && *text != '\n')
+        {
+            text = (const char*) memchr(text, '\n', end - text);
+            text = (text == NULL) ? end : text;
+        }
+        if (text < end)
+        {
+            text++;
+        }
+    }
+    m_line = line - 1;
+    return true;
+}
+
+/* Little-endian uint32s, end - begin a multiple of four */
+bool ObservationLoader::parseBinary(const char *begin, const char *end, std::vector<uint32_t> *values)
+{
+    size_t count = (end - begin) / sizeof(uint32_t);
+    Reserve(values, count);
+    const unsigned char *bytes = (const unsigned char*) begin;
+    for (size_t index = 0; index < count; ++index, bytes += sizeof(uint32_t))
+    {
+        values->push_back(bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24));
+    }
+    m_line += count;
+    return true;
+}
+
+bool ObservationLoader::failPartial(size_t leftOver)
+{
+    std::ostringstream text;
+    text << "it ends " << leftOver << " byte(s) into value " << m_line + 1 << ", binary input is whole 32-bit values";
+    m_error = text.str();
+    return false;
+}
+
+bool ObservationLoader::fail(uint64_t line, const std::string& message)
+{
+    std::ostringstream text;
+    text << "line " << line << ": " << message;
+    m_error = text.str();
+    return false;
+}
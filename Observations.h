@@ -0,0 +1,51 @@
+/*
+ * Observations.h
+ *
+ *  Loads the observed values given with -i. The file is mapped rather than
+ *  read, its lines are counted so the values go into a single allocation,
+ *  and numbers are scanned eight digits at a time. Values are decimal or 0x
+ *  hex, one per line or in a chosen CSV column, or raw little-endian uint32s,
+ *  and anything else stops the load with the line it was on. Stdin and pipes
+ *  are parsed in chunks as they are read.
+ */
+
+#ifndef OBSERVATIONS_H_
+#define OBSERVATIONS_H_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/* How the values are laid out in the input */
+struct InputFormat
+{
+    unsigned int column;  // CSV column to take the values from, counting from 1, or 0 for one value per line
+    bool isBinary;        // Little-endian uint32s rather than text
+};
+
+class ObservationLoader
+{
+public:
+    explicit ObservationLoader(const InputFormat& format);
+
+    /* "text", "csv:<column>" or "binary", false if it's none of them */
+    static bool parseFormat(const std::string& text, InputFormat *format);
+
+    /* Appends every value in the file ("-" for stdin), false at the first bad one, see error() */
+    bool load(const std::string& path, std::vector<uint32_t> *values);
+    const std::string& error() const;
+
+private:
+    bool loadMapped(int file, size_t size, std::vector<uint32_t> *values);
+    bool loadStream(int file, std::vector<uint32_t> *values);
+    bool parse(const char *begin, const char *end, std::vector<uint32_t> *values);
+    bool parseBinary(const char *begin, const char *end, std::vector<uint32_t> *values);
+    bool fail(uint64_t line, const std::string& message);
+    bool failPartial(size_t leftOver);
+
+    InputFormat m_format;
+    std::string m_error;
+    uint64_t m_line;  // Lines (or binary values) parsed so far
+};
+
+#endif /* OBSERVATIONS_H_ */
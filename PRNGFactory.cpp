@@ -12,6 +12,35 @@ PRNGFactory::PRNGFactory()
     library[GLIBC_RAND] = &create<GlibcRand>;
     library[MT19937] = &create<Mt19937>;
     library[RUBY_RAND] = &create<Ruby>;
+
+    verifiers[GLIBC_RAND] = &BruteForce<GlibcRandKernel>;
+    verifiers[MT19937] = &BruteForce<Mt19937Kernel>;
+    verifiers[RUBY_RAND] = &BruteForce<RubyKernel>;
+
+    addKernel(GLIBC_RAND, "scalar", &Filter<GlibcRandKernel>);
+    addKernel(MT19937, "scalar", &Filter<Mt19937Kernel>);
+    addKernel(RUBY_RAND, "scalar", &Filter<RubyKernel>);
+
+#if defined(__x86_64__) || defined(__i386__)
+    /* Ruby's rand() here is MT19937 seeded with init_genrand(), so it shares the MT lanes */
+    addKernel(GLIBC_RAND, "sse4", &FilterSse4<GlibcRandLanes>);
+    addKernel(MT19937, "sse4", &FilterSse4<Mt19937Lanes>);
+    addKernel(RUBY_RAND, "sse4", &FilterSse4<Mt19937Lanes>);
+
+    addKernel(GLIBC_RAND, "avx2", &FilterAvx2<GlibcRandLanes>);
+    addKernel(MT19937, "avx2", &FilterAvx2<Mt19937Lanes>);
+    addKernel(RUBY_RAND, "avx2", &FilterAvx2<Mt19937Lanes>);
+
+    addKernel(GLIBC_RAND, "avx512", &FilterAvx512<GlibcRandLanes>);
+    addKernel(MT19937, "avx512", &FilterAvx512<Mt19937Lanes>);
+    addKernel(RUBY_RAND, "avx512", &FilterAvx512<Mt19937Lanes>);
+#endif
+}
+
+void PRNGFactory::addKernel(const std::string& name, const std::string& variant, FilterKernel filter)
+{
+    KernelVariant entry = {variant, filter};
+    kernels[name].push_back(entry);
 }
 
 PRNGFactory::~PRNGFactory() {}
@@ -22,6 +51,56 @@ PRNG* PRNGFactory::getInstance(std::string name)
     return library[name]();
 }
 
+/* The named variant, or the fastest one this CPU supports if no variant is given */
+KernelVariant PRNGFactory::getKernel(std::string name, std::string variant)
+{
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    std::vector<KernelVariant>& variants = kernels[name];
+    KernelVariant best = variants[0];
+    for (unsigned int index = 0; index < variants.size(); ++index)
+    {
+        if (variant.empty() ? isVariantSupported(variants[index].name) : variants[index].name == variant)
+        {
+            best = variants[index];
+        }
+    }
+    return best;
+}
+
+/* The exact, scalar search used on the seeds a filter lets through */
+SearchKernel PRNGFactory::getVerifier(std::string name)
+{
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+    return verifiers[name];
+}
+
+/* Checks CPUID for the instruction sets a kernel variant was compiled for */
+bool PRNGFactory::isVariantSupported(const std::string& variant)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (variant == "sse4")
+        return __builtin_cpu_supports("sse4.2");
+    if (variant == "avx2")
+        return __builtin_cpu_supports("avx2");
+    if (variant == "avx512")
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512vl");
+#endif
+    return variant == "scalar";
+}
+
+std::vector<std::string> PRNGFactory::getVariantNames()
+{
+    std::vector<std::string> names;
+    std::vector<KernelVariant>& variants = kernels.begin()->second;
+    for (unsigned int index = 0; index < variants.size(); ++index)
+    {
+        names.push_back(variants[index].name);
+    }
+    return names;
+}
+
 std::vector<std::string> PRNGFactory::getNames()
 {
     std::vector<std::string> names;
@@ -31,3 +110,51 @@ std::vector<std::string> PRNGFactory::getNames()
     }
     return names;
 }
+
+/*
+    Quick check of a filter kernel against the PRNG's own class, which shares
+    no code with it: a chunk that isn't a whole number of lanes, running up to
+    the last seed, with a depth across a block boundary. Values are planted at
+    the last position the filter must look at and at the first it must not.
+    True if the kernel lets exactly the right seeds through both times.
+*/
+bool PRNGFactory::checkKernel(std::string name, std::string variant)
+{
+    const uint32_t firstSeed = 4294967295U - 36;
+    const uint32_t seedCount = 37;
+    const uint32_t depth = KERNEL_BLOCK_SIZE + 44;
+
+    PRNG *generator = getInstance(name);
+    std::vector<std::vector<uint32_t> > outputs(seedCount, std::vector<uint32_t>(depth + 1));
+    for (uint32_t index = 0; index < seedCount; ++index)
+    {
+        generator->seed(firstSeed + index);
+        generator->fill(&outputs[index][0], depth + 1);
+    }
+    delete generator;
+
+    FilterKernel filter = getKernel(name, variant).filter;
+    for (uint32_t position = depth - 1; position <= depth; ++position)
+    {
+        std::vector<uint32_t> observed(2, outputs[seedCount / 2][position]);
+        std::vector<uint32_t> expected;
+        for (uint32_t index = 0; index < seedCount; ++index)
+        {
+            if (std::find(outputs[index].begin(), outputs[index].begin() + depth, observed[0]) != outputs[index].begin() + depth)
+            {
+                expected.push_back(firstSeed + index);
+            }
+        }
+
+        std::vector<uint32_t> survivors;
+        SearchChunk chunk = {&observed[0], (uint32_t) observed.size(), depth, 100.0, 0, firstSeed,
+                             (uint64_t) firstSeed + seedCount - 1, NULL};
+        filter(chunk, &survivors);
+        std::sort(survivors.begin(), survivors.end());
+        if (survivors != expected)
+        {
+            return false;
+        }
+    }
+    return true;
+}
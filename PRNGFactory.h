@@ -15,11 +15,22 @@
 #include "prngs/Mt19937.h"
 #include "prngs/GlibcRand.h"
 #include "prngs/Ruby.h"
+#include "BruteForce.h"
 
 /* Template to bind constructor to mapped string */
 template<typename T> PRNG* create() { return new T; }
 typedef std::map<std::string, PRNG* (*)()> PRNGLibrary;
 
+/* One compiled flavor of a PRNG's filter kernel */
+struct KernelVariant
+{
+    std::string name;  // scalar, sse4, avx2 or avx512
+    FilterKernel filter;
+};
+
+/* Variants of each PRNG's kernel, slowest first */
+typedef std::map<std::string, std::vector<KernelVariant> > KernelLibrary;
+
 class PRNGFactory
 {
 public:
@@ -27,10 +38,19 @@ public:
     virtual ~PRNGFactory();
 
     PRNG* getInstance(std::string);
+    KernelVariant getKernel(std::string name, std::string variant = "");
+    SearchKernel getVerifier(std::string name);
     std::vector<std::string> getNames(void);
+    std::vector<std::string> getVariantNames(void);
+    static bool isVariantSupported(const std::string&);
+    bool checkKernel(std::string name, std::string variant = "");
 
 private:
+    void addKernel(const std::string&, const std::string&, FilterKernel);
+
     PRNGLibrary library;
+    KernelLibrary kernels;
+    std::map<std::string, SearchKernel> verifiers;
 };
 
 #endif /* PRNGFACTORY_H_ */
@@ -0,0 +1,305 @@
+/*
+ * Results.cpp
+ *
+ *  Bounded per-worker seed heaps, the binary spill file and the JSON
+ *  result stream.
+ */
+
+#include "Results.h"
+
+#include <algorithm>
+#include <sstream>
+
+/* True if a is the better seed: more confident, then the earlier PRNG, then the lower seed */
+static bool IsBetter(const Seed& a, const Seed& b)
+{
+    if (a.confidence != b.confidence)
+        return b.confidence < a.confidence;
+    if (a.engine != b.engine)
+        return a.engine < b.engine;
+    return a.value < b.value;
+}
+
+TopSeeds::TopSeeds(size_t capacity) : m_capacity(capacity), m_offered(0) {}
+
+void TopSeeds::add(const Seed& seed)
+{
+    m_offered++;
+    keep(seed);
+}
+
+void TopSeeds::raise(const Seed& seed)
+{
+    hold(seed);
+}
+
+/* Workers verifying a seed at different tiers both hold it, so only its best is kept */
+void TopSeeds::hold(const Seed& seed)
+{
+    for (unsigned int index = 0; index < m_heap.size(); ++index)
+    {
+        if (m_heap[index].engine == seed.engine && m_heap[index].value == seed.value)
+        {
+            if (m_heap[index].confidence < seed.confidence)
+            {
+                m_heap[index] = seed;
+                std::make_heap(m_heap.begin(), m_heap.end(), IsBetter);
+            }
+            return;
+        }
+    }
+    keep(seed);
+}
+
+void TopSeeds::keep(const Seed& seed)
+{
+    if (m_heap.size() < m_capacity)
+    {
+        m_heap.push_back(seed);
+        std::push_heap(m_heap.begin(), m_heap.end(), IsBetter);
+    }
+    else if (!m_heap.empty() && IsBetter(seed, m_heap.front()))
+    {
+        std::pop_heap(m_heap.begin(), m_heap.end(), IsBetter);
+        m_heap.back() = seed;
+        std::push_heap(m_heap.begin(), m_heap.end(), IsBetter);
+    }
+}
+
+void TopSeeds::merge(const TopSeeds& other)
+{
+    for (unsigned int index = 0; index < other.m_heap.size(); ++index)
+    {
+        hold(other.m_heap[index]);
+    }
+    m_offered += other.m_offered;
+}
+
+std::vector<Seed> TopSeeds::sorted() const
+{
+    std::vector<Seed> seeds(m_heap);
+    std::sort(seeds.begin(), seeds.end(), IsBetter);
+    return seeds;
+}
+
+size_t TopSeeds::capacity() const
+{
+    return m_capacity;
+}
+
+uint64_t TopSeeds::offered() const
+{
+    return m_offered;
+}
+
+SeedSpill::SeedSpill() : m_file(NULL), m_count(0), m_isFailed(false) {}
+
+SeedSpill::~SeedSpill()
+{
+    close();
+}
+
+bool SeedSpill::open(const std::string& path)
+{
+    close();
+    m_file = fopen(path.c_str(), "wb");
+    m_count = 0;
+    m_isFailed = false;
+    return m_file != NULL;
+}
+
+bool SeedSpill::isOpen() const
+{
+    return m_file != NULL;
+}
+
+void SeedSpill::write(const std::vector<Seed>& seeds)
+{
+    std::vector<unsigned char> records(seeds.size() * SPILL_RECORD_SIZE);
+    for (unsigned int index = 0; index < seeds.size(); ++index)
+    {
+        unsigned char *record = &records[index * SPILL_RECORD_SIZE];
+        uint32_t value = seeds[index].value;
+        uint16_t engine = (uint16_t) seeds[index].engine;
+        uint16_t confidence = (uint16_t) (seeds[index].confidence * 100.0 + 0.5);
+        record[0] = value;
+        record[1] = value >> 8;
+        record[2] = value >> 16;
+        record[3] = value >> 24;
+        record[4] = engine;
+        record[5] = engine >> 8;
+        record[6] = confidence;
+        record[7] = confidence >> 8;
+    }
+
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_file == NULL || records.empty())
+    {
+        return;
+    }
+    if (fwrite(&records[0], SPILL_RECORD_SIZE, seeds.size(), m_file) != seeds.size())
+    {
+        m_isFailed = true;
+    }
+    m_count += seeds.size();
+}
+
+bool SeedSpill::close()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_file == NULL)
+    {
+        return !m_isFailed;
+    }
+    if (fclose(m_file) != 0)
+    {
+        m_isFailed = true;
+    }
+    m_file = NULL;
+    return !m_isFailed;
+}
+
+uint64_t SeedSpill::count() const
+{
+    return m_count;
+}
+
+ResultStream::ResultStream() : m_out(NULL), m_queue(STREAM_QUEUE_SIZE), m_start(std::chrono::steady_clock::now()), m_hits(0) {}
+
+ResultStream::~ResultStream()
+{
+    close();
+}
+
+bool ResultStream::open(const std::string& path)
+{
+    m_file.open(path.c_str());
+    m_out = m_file.is_open() ? &m_file : NULL;
+    return m_out != NULL;
+}
+
+void ResultStream::attach(std::streambuf *buffer)
+{
+    m_out = new std::ostream(buffer);
+}
+
+bool ResultStream::isOpen() const
+{
+    return m_out != NULL;
+}
+
+void ResultStream::setNames(const std::vector<std::string>& names)
+{
+    m_names = names;
+}
+
+void ResultStream::push(const Seed& seed)
+{
+    StreamedSeed record = {seed, elapsed(), timestamp()};
+    while (!m_queue.push(record))
+    {
+        drain();
+    }
+}
+
+void ResultStream::drain()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    StreamedSeed record;
+    bool isWritten = false;
+    while (m_queue.pop(&record))
+    {
+        if (m_out == NULL)
+        {
+            continue;
+        }
+        const std::string& name = (record.seed.engine < m_names.size()) ? m_names[record.seed.engine] : "";
+        std::ostringstream line;
+        line << "{\"type\": \"hit\", \"seed\": " << record.seed.value << ", \"prng\": \"" << name
+             << "\", \"confidence\": " << record.seed.confidence << ", \"offset\": " << record.seed.offset;
+        line.setf(std::ios::fixed);
+        line.precision(3);
+        line << ", \"elapsed\": " << record.elapsed << ", \"timestamp\": " << record.timestamp << "}";
+        write(line.str());
+        m_hits++;
+        isWritten = true;
+    }
+    if (isWritten)
+    {
+        m_out->flush();
+    }
+}
+
+void ResultStream::progress(double percent, uint64_t seeds)
+{
+    std::ostringstream fields;
+    fields.setf(std::ios::fixed);
+    fields.precision(3);
+    fields << "\"type\": \"progress\", \"percent\": " << percent << ", \"seeds\": " << seeds;
+    status(fields.str());
+}
+
+void ResultStream::done(uint64_t seeds, bool isOverBudget)
+{
+    std::ostringstream fields;
+    fields << "\"type\": \"done\", \"seeds\": " << seeds << ", \"overBudget\": " << (isOverBudget ? "true" : "false");
+    status(fields.str());
+}
+
+bool ResultStream::close()
+{
+    drain();
+    std::lock_guard<std::mutex> lock(m_lock);
+    if (m_out == NULL)
+    {
+        return true;
+    }
+    m_out->flush();
+    bool isGood = m_out->good();
+    if (m_out == &m_file)
+    {
+        m_file.close();
+    }
+    else
+    {
+        delete m_out;
+    }
+    m_out = NULL;
+    return isGood;
+}
+
+/* A progress or done record, after every hit found so far */
+void ResultStream::status(const std::string& fields)
+{
+    drain();
+    std::lock_guard<std::mutex> lock(m_lock);
+    std::ostringstream line;
+    line.setf(std::ios::fixed);
+    line.precision(3);
+    line << "{" << fields << ", \"hits\": " << m_hits << ", \"elapsed\": " << elapsed()
+         << ", \"timestamp\": " << timestamp() << "}";
+    write(line.str());
+    if (m_out != NULL)
+    {
+        m_out->flush();
+    }
+}
+
+/* One record, with the lock held */
+void ResultStream::write(const std::string& record)
+{
+    if (m_out != NULL)
+    {
+        *m_out << record << '\n';
+    }
+}
+
+double ResultStream::elapsed() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+double ResultStream::timestamp()
+{
+    return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
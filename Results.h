@@ -0,0 +1,141 @@
+/*
+ * Results.h
+ *
+ *  Where the brute force puts the seeds it verifies. Each worker keeps only
+ *  its most confident seeds in a bounded heap, and the heaps are merged once
+ *  the workers are done, so a low -c threshold can't run the box out of
+ *  memory however many seeds pass it. Every seed that passes can also be
+ *  spilled to a compact binary file, or streamed out as JSON, as it is found.
+ */
+
+#ifndef RESULTS_H_
+#define RESULTS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "BruteForce.h"
+#include "LockFreeQueue.h"
+
+/* Size of a spill file record: seed, PRNG index, confidence */
+static const size_t SPILL_RECORD_SIZE = 8;
+
+/* Seeds that can wait for the stream to be written out */
+static const size_t STREAM_QUEUE_SIZE = 4096;
+
+/* The most confident seeds offered, up to a fixed number */
+class TopSeeds
+{
+public:
+    explicit TopSeeds(size_t capacity = 0);
+
+    /* Kept while there's room, then only if it beats the worst seed held */
+    void add(const Seed& seed);
+
+    /* A seed held by both is kept once, with the higher confidence */
+    void merge(const TopSeeds& other);
+
+    /* A seed offered before, found again with a higher confidence: it takes its
+        old place if that is held here, and is never counted twice */
+    void raise(const Seed& seed);
+
+    /* Every seed kept, each once, most confident first */
+    std::vector<Seed> sorted() const;
+    size_t capacity() const;
+
+    /* How many distinct seeds were offered, kept or not, raises aside */
+    uint64_t offered() const;
+
+private:
+    void hold(const Seed& seed);
+    void keep(const Seed& seed);
+
+    std::vector<Seed> m_heap;  // The worst seed kept is on top
+    size_t m_capacity;
+    uint64_t m_offered;
+};
+
+/*
+    A file of every seed that passed, SPILL_RECORD_SIZE bytes each, all little
+    endian: the seed (uint32), the PRNG's index in PRNGFactory::getNames() (uint16) and
+    the confidence in hundredths of a percent (uint16). Workers write in
+    batches, under a lock.
+*/
+class SeedSpill
+{
+public:
+    SeedSpill();
+    ~SeedSpill();
+
+    bool open(const std::string& path);
+    bool isOpen() const;
+    void write(const std::vector<Seed>& seeds);
+
+    /* Flushes and closes the file, false if any write failed */
+    bool close();
+    uint64_t count() const;
+
+private:
+    FILE *m_file;
+    std::mutex m_lock;
+    uint64_t m_count;
+    bool m_isFailed;
+};
+
+/* A seed on its way to the result stream, and when it was found */
+struct StreamedSeed
+{
+    Seed seed;
+    double elapsed;    // Seconds since the stream was opened
+    double timestamp;  // Seconds since the Unix epoch
+};
+
+/*
+    Newline delimited JSON, one record per line: a "hit" for every seed that
+    passes, as soon as it's verified, "progress" now and then, and "done" at
+    the end. Workers push hits onto a lock-free queue and whoever drains it
+    (normally the status thread) writes them. A worker that finds the queue
+    full drains it itself, so it never waits on a thread that has stopped.
+*/
+class ResultStream
+{
+public:
+    ResultStream();
+    ~ResultStream();
+
+    /* A file to write to, or else a stream buffer that's already open, such as stdout's */
+    bool open(const std::string& path);
+    void attach(std::streambuf *buffer);
+    bool isOpen() const;
+
+    /* The PRNG names that seeds' engine indices refer to */
+    void setNames(const std::vector<std::string>& names);
+
+    void push(const Seed& seed);
+    void drain();
+    void progress(double percent, uint64_t seeds);
+    void done(uint64_t seeds, bool isOverBudget);
+    bool close();
+
+private:
+    void status(const std::string& fields);
+    void write(const std::string& record);
+    double elapsed() const;
+    static double timestamp();
+
+    std::ofstream m_file;
+    std::ostream *m_out;
+    LockFreeQueue<StreamedSeed> m_queue;
+    std::mutex m_lock;      // Held while writing
+    std::vector<std::string> m_names;
+    std::chrono::steady_clock::time_point m_start;
+    uint64_t m_hits;
+};
+
+#endif /* RESULTS_H_ */
@@ -0,0 +1,216 @@
+/*
+ * Telemetry.cpp
+ *
+ *  Per worker, per PRNG search counters, and the perf_event_open counters
+ *  that go with them.
+ */
+
+#include "Telemetry.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <new>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+void TelemetryTotals::add(const TelemetryTotals& other)
+{
+    seeds += other.seeds;
+    outputs += other.outputs;
+    rejects += other.rejects;
+    nanoseconds += other.nanoseconds;
+    cycles += other.cycles;
+    instructions += other.instructions;
+}
+
+Telemetry::Telemetry(unsigned int workers, unsigned int engines)
+    : m_workers(workers), m_engines(engines), m_storage((size_t) workers * engines * sizeof(TelemetrySlot) + CACHE_LINE_SIZE)
+{
+    /* std::vector won't align to more than 16 bytes before C++17, so line the slots up by hand */
+    uintptr_t address = (uintptr_t) &m_storage[0];
+    address = (address + CACHE_LINE_SIZE - 1) & ~(uintptr_t) (CACHE_LINE_SIZE - 1);
+    m_slots = (TelemetrySlot*) address;
+    for (unsigned int index = 0; index < m_workers * m_engines; ++index)
+    {
+        TelemetrySlot *slot = new (&m_slots[index]) TelemetrySlot;
+        slot->seeds.store(0, std::memory_order_relaxed);
+        slot->outputs.store(0, std::memory_order_relaxed);
+        slot->rejects.store(0, std::memory_order_relaxed);
+        slot->nanoseconds.store(0, std::memory_order_relaxed);
+        slot->cycles.store(0, std::memory_order_relaxed);
+        slot->instructions.store(0, std::memory_order_relaxed);
+    }
+}
+
+Telemetry::~Telemetry()
+{
+    for (unsigned int index = 0; index < m_workers * m_engines; ++index)
+    {
+        m_slots[index].~TelemetrySlot();
+    }
+}
+
+TelemetrySlot& Telemetry::slot(unsigned int worker, unsigned int engine) const
+{
+    return m_slots[worker * m_engines + engine];
+}
+
+/* Single writer per slot, so there is no need for a locked read-modify-write */
+static void Bump(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+void Telemetry::add(unsigned int worker, unsigned int engine, const TelemetryTotals& delta)
+{
+    TelemetrySlot& counters = slot(worker, engine);
+    Bump(counters.seeds, delta.seeds);
+    Bump(counters.outputs, delta.outputs);
+    Bump(counters.rejects, delta.rejects);
+    Bump(counters.nanoseconds, delta.nanoseconds);
+    Bump(counters.cycles, delta.cycles);
+    Bump(counters.instructions, delta.instructions);
+}
+
+TelemetryTotals Telemetry::read(const TelemetrySlot& counters) const
+{
+    TelemetryTotals totals;
+    totals.seeds = counters.seeds.load(std::memory_order_relaxed);
+    totals.outputs = counters.outputs.load(std::memory_order_relaxed);
+    totals.rejects = counters.rejects.load(std::memory_order_relaxed);
+    totals.nanoseconds = counters.nanoseconds.load(std::memory_order_relaxed);
+    totals.cycles = counters.cycles.load(std::memory_order_relaxed);
+    totals.instructions = counters.instructions.load(std::memory_order_relaxed);
+    return totals;
+}
+
+TelemetryTotals Telemetry::engineTotals(unsigned int engine) const
+{
+    TelemetryTotals totals;
+    for (unsigned int worker = 0; worker < m_workers; ++worker)
+    {
+        totals.add(read(slot(worker, engine)));
+    }
+    return totals;
+}
+
+TelemetryTotals Telemetry::workerTotals(unsigned int worker) const
+{
+    TelemetryTotals totals;
+    for (unsigned int engine = 0; engine < m_engines; ++engine)
+    {
+        totals.add(read(slot(worker, engine)));
+    }
+    return totals;
+}
+
+TelemetryTotals Telemetry::totals() const
+{
+    TelemetryTotals totals;
+    for (unsigned int worker = 0; worker < m_workers; ++worker)
+    {
+        totals.add(workerTotals(worker));
+    }
+    return totals;
+}
+
+static void WriteCounters(std::ostream& out, const TelemetryTotals& totals)
+{
+    double filterSeconds = (double) totals.nanoseconds / 1e9;
+    out << "\"seeds\": " << totals.seeds << ", \"outputs\": " << totals.outputs
+        << ", \"rejects\": " << totals.rejects << ", \"filterSeconds\": " << filterSeconds
+        << ", \"seedsPerThreadSecond\": " << ((0.0 < filterSeconds) ? (double) totals.seeds / filterSeconds : 0.0)
+        << ", \"cycles\": " << totals.cycles << ", \"instructions\": " << totals.instructions
+        << ", \"ipc\": " << ((0 < totals.cycles) ? (double) totals.instructions / (double) totals.cycles : 0.0);
+}
+
+void Telemetry::writeJson(std::ostream& out, const std::vector<std::string>& names, double seconds) const
+{
+    TelemetryTotals all = totals();
+    out << "{\n  \"seconds\": " << seconds << ",\n  \"threads\": " << m_workers
+        << ",\n  \"seedsPerSecond\": " << ((0.0 < seconds) ? (double) all.seeds / seconds : 0.0)
+        << ",\n  \"engines\": [";
+    for (unsigned int engine = 0; engine < m_engines; ++engine)
+    {
+        out << ((engine == 0) ? "\n" : ",\n") << "    {\"name\": \"" << names[engine] << "\", ";
+        WriteCounters(out, engineTotals(engine));
+        out << "}";
+    }
+    out << "\n  ],\n  \"workers\": [";
+    for (unsigned int worker = 0; worker < m_workers; ++worker)
+    {
+        out << ((worker == 0) ? "\n" : ",\n") << "    {\"id\": " << worker << ", ";
+        WriteCounters(out, workerTotals(worker));
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+#ifdef __linux__
+
+static int OpenCounter(uint64_t config, int leader)
+{
+    struct perf_event_attr attributes;
+    memset(&attributes, 0, sizeof(attributes));
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = config;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_GROUP;
+    return (int) syscall(__NR_perf_event_open, &attributes, 0, -1, leader, 0);
+}
+
+PerfCounters::PerfCounters() : m_leader(-1), m_instructions(-1)
+{
+    m_leader = OpenCounter(PERF_COUNT_HW_CPU_CYCLES, -1);
+    if (m_leader < 0)
+    {
+        return;
+    }
+    m_instructions = OpenCounter(PERF_COUNT_HW_INSTRUCTIONS, m_leader);
+    if (m_instructions < 0)
+    {
+        close(m_leader);
+        m_leader = -1;
+    }
+}
+
+PerfCounters::~PerfCounters()
+{
+    if (m_instructions >= 0)
+        close(m_instructions);
+    if (m_leader >= 0)
+        close(m_leader);
+}
+
+bool PerfCounters::isOpen() const
+{
+    return m_leader >= 0;
+}
+
+bool PerfCounters::read(uint64_t *cycles, uint64_t *instructions) const
+{
+    uint64_t values[3];  // Number of counters, then each counter in the order they joined the group
+    if (!isOpen() || ::read(m_leader, values, sizeof(values)) != (ssize_t) sizeof(values))
+    {
+        return false;
+    }
+    *cycles = values[1];
+    *instructions = values[2];
+    return true;
+}
+
+#else
+
+PerfCounters::PerfCounters() : m_leader(-1), m_instructions(-1) {}
+PerfCounters::~PerfCounters() {}
+bool PerfCounters::isOpen() const { return false; }
+bool PerfCounters::read(uint64_t *, uint64_t *) const { return false; }
+
+#endif /* __linux__ */
@@ -0,0 +1,93 @@
+/*
+ * Telemetry.h
+ *
+ *  Counters the brute force workers publish while they run. Every worker
+ *  gets one slot per PRNG on a cache line of its own, and only ever writes
+ *  its own slots, so updates are a plain load and store with no lock and no
+ *  false sharing; the status thread reads them whenever it likes. Cycles
+ *  and instructions come from perf_event_open where the kernel allows it.
+ */
+
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+
+static const size_t CACHE_LINE_SIZE = 64;
+
+/* A snapshot of, or an addition to, one or more slots */
+struct TelemetryTotals
+{
+    TelemetryTotals() : seeds(0), outputs(0), rejects(0), nanoseconds(0), cycles(0), instructions(0) {}
+    uint64_t seeds;         // Seeds run through the filter
+    uint64_t outputs;       // Generator outputs the filter looked at, at most
+    uint64_t rejects;       // Seeds the filter dropped without verifying
+    uint64_t nanoseconds;   // Spent in the filter
+    uint64_t cycles;        // Zero unless perf counters are open
+    uint64_t instructions;
+
+    void add(const TelemetryTotals& other);
+};
+
+/* One worker's counters for one PRNG */
+struct TelemetrySlot
+{
+    std::atomic<uint64_t> seeds;
+    std::atomic<uint64_t> outputs;
+    std::atomic<uint64_t> rejects;
+    std::atomic<uint64_t> nanoseconds;
+    std::atomic<uint64_t> cycles;
+    std::atomic<uint64_t> instructions;
+    char padding[CACHE_LINE_SIZE - 6 * sizeof(std::atomic<uint64_t>)];
+};
+
+class Telemetry
+{
+public:
+    Telemetry(unsigned int workers, unsigned int engines);
+    ~Telemetry();
+
+    /* Only the worker that owns the slot may call this */
+    void add(unsigned int worker, unsigned int engine, const TelemetryTotals& delta);
+
+    TelemetryTotals engineTotals(unsigned int engine) const;
+    TelemetryTotals workerTotals(unsigned int worker) const;
+    TelemetryTotals totals() const;
+
+    /* The whole run as a JSON object, engines named in the order they were counted */
+    void writeJson(std::ostream& out, const std::vector<std::string>& names, double seconds) const;
+
+private:
+    TelemetrySlot& slot(unsigned int worker, unsigned int engine) const;
+    TelemetryTotals read(const TelemetrySlot& slot) const;
+
+    unsigned int m_workers;
+    unsigned int m_engines;
+    std::vector<unsigned char> m_storage;
+    TelemetrySlot *m_slots;  // Inside m_storage, aligned to a cache line
+};
+
+/* Hardware cycles and instructions retired by the thread that opened them */
+class PerfCounters
+{
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    /* False when perf_event_open is missing or not permitted */
+    bool isOpen() const;
+    bool read(uint64_t *cycles, uint64_t *instructions) const;
+
+private:
+    PerfCounters(const PerfCounters&);
+    PerfCounters& operator=(const PerfCounters&);
+
+    int m_leader;  // Cycles, read together with the instructions counter as one group
+    int m_instructions;
+};
+
+#endif /* TELEMETRY_H_ */
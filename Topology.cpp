@@ -0,0 +1,240 @@
+/*
+ * Topology.cpp
+ *
+ *  CPU affinity, NUMA nodes, hyperthread siblings and cgroup CPU quotas,
+ *  as Linux reports them under /proc and /sys.
+ */
+
+#include "Topology.h"
+
+#include <stdlib.h>
+#include <math.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#include <pthread.h>
+#endif
+
+#ifdef __linux__
+
+/* The first line of a file, empty if it can't be read */
+static std::string ReadLine(const std::string& path)
+{
+    std::ifstream file(path.c_str());
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+/* A kernel CPU list such as "0-3,8-11" */
+static std::vector<int> ParseCpuList(const std::string& text)
+{
+    std::vector<int> cpus;
+    std::stringstream list(text);
+    std::string range;
+    while (std::getline(list, range, ','))
+    {
+        if (range.empty())
+            continue;
+        size_t dash = range.find('-');
+        int first = atoi(range.c_str());
+        int last = (dash == std::string::npos) ? first : atoi(range.c_str() + dash + 1);
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/* CPUs' worth of time per period from cgroup v2 cpu.max ("max 100000" or "200000 100000") */
+static double ParseCpuMax(const std::string& text)
+{
+    std::stringstream fields(text);
+    std::string quota;
+    double period = 0.0;
+    fields >> quota >> period;
+    return (quota == "max" || quota.empty() || period <= 0.0) ? 0.0 : atof(quota.c_str()) / period;
+}
+
+/* The CPU quota of the cgroup this process is in, v2 or v1, 0 if there's none */
+static double CgroupQuota()
+{
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(cgroups, line))
+    {
+        /* hierarchy-ID:controller-list:path */
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos)
+            continue;
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string path = line.substr(second + 1);
+        if (path == "/")
+            path = "";
+
+        if (controllers.empty())
+        {
+            std::string text = ReadLine("/sys/fs/cgroup" + path + "/cpu.max");
+            if (text.empty())
+                text = ReadLine("/sys/fs/cgroup/cpu.max");
+            if (!text.empty())
+                return ParseCpuMax(text);
+            continue;
+        }
+
+        std::stringstream names(controllers);
+        std::string name;
+        while (std::getline(names, name, ','))
+        {
+            if (name != "cpu")
+                continue;
+            const std::string roots[] = {"/sys/fs/cgroup/" + controllers + path, "/sys/fs/cgroup/cpu" + path, "/sys/fs/cgroup/cpu"};
+            for (unsigned int index = 0; index < sizeof(roots) / sizeof(roots[0]); ++index)
+            {
+                std::string quota = ReadLine(roots[index] + "/cpu.cfs_quota_us");
+                double period = atof(ReadLine(roots[index] + "/cpu.cfs_period_us").c_str());
+                if (!quota.empty() && 0.0 < period)
+                {
+                    return (atof(quota.c_str()) < 0.0) ? 0.0 : atof(quota.c_str()) / period;
+                }
+            }
+        }
+    }
+    return 0.0;
+}
+
+Topology::Topology() : m_nodes(1), m_quota(CgroupQuota())
+{
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    std::vector<int> allowed;
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &mask))
+                allowed.push_back(cpu);
+        }
+    }
+
+    /* Node of every CPU, node 0 for any the kernel doesn't list */
+    std::vector<unsigned int> nodeOf(CPU_SETSIZE, 0);
+    std::vector<int> nodeIds;
+    DIR *nodes = opendir("/sys/devices/system/node");
+    if (nodes != NULL)
+    {
+        for (struct dirent *entry = readdir(nodes); entry != NULL; entry = readdir(nodes))
+        {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") == 0 && 4 < name.size() && isdigit(name[4]))
+                nodeIds.push_back(atoi(name.c_str() + 4));
+        }
+        closedir(nodes);
+    }
+    std::sort(nodeIds.begin(), nodeIds.end());
+    for (unsigned int index = 0; index < nodeIds.size(); ++index)
+    {
+        std::ostringstream path;
+        path << "/sys/devices/system/node/node" << nodeIds[index] << "/cpulist";
+        std::vector<int> cpus = ParseCpuList(ReadLine(path.str()));
+        for (unsigned int cpu = 0; cpu < cpus.size(); ++cpu)
+        {
+            if (0 <= cpus[cpu] && cpus[cpu] < CPU_SETSIZE)
+                nodeOf[cpus[cpu]] = index;
+        }
+    }
+    m_nodes = std::max((size_t) 1, nodeIds.size());
+
+    /* Bucket by how many siblings come before each CPU on its core, then by node */
+    std::vector<std::vector<std::vector<CpuSlot> > > buckets;
+    for (unsigned int index = 0; index < allowed.size(); ++index)
+    {
+        std::ostringstream path;
+        path << "/sys/devices/system/cpu/cpu" << allowed[index] << "/topology/thread_siblings_list";
+        std::vector<int> siblings = ParseCpuList(ReadLine(path.str()));
+        unsigned int rank = std::find(siblings.begin(), siblings.end(), allowed[index]) - siblings.begin();
+        rank = std::min(rank, (unsigned int) siblings.size());
+        if (buckets.size() <= rank)
+            buckets.resize(rank + 1, std::vector<std::vector<CpuSlot> >(m_nodes));
+        CpuSlot slot = {allowed[index], nodeOf[allowed[index]]};
+        buckets[rank][slot.node].push_back(slot);
+    }
+    for (unsigned int rank = 0; rank < buckets.size(); ++rank)
+    {
+        for (unsigned int turn = 0; ; ++turn)
+        {
+            bool isTaken = false;
+            for (unsigned int node = 0; node < m_nodes; ++node)
+            {
+                if (turn < buckets[rank][node].size())
+                {
+                    m_order.push_back(buckets[rank][node][turn]);
+                    isTaken = true;
+                }
+            }
+            if (!isTaken)
+                break;
+        }
+    }
+}
+
+bool Topology::pin(int cpu)
+{
+    if (cpu < 0 || CPU_SETSIZE <= cpu)
+    {
+        return false;
+    }
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+}
+
+#else
+
+Topology::Topology() : m_nodes(1), m_quota(0.0) {}
+
+bool Topology::pin(int)
+{
+    return false;
+}
+
+#endif /* __linux__ */
+
+unsigned int Topology::cpuCount() const
+{
+    return m_order.empty() ? std::max(1U, std::thread::hardware_concurrency()) : m_order.size();
+}
+
+unsigned int Topology::nodeCount() const
+{
+    return m_nodes;
+}
+
+unsigned int Topology::defaultThreads() const
+{
+    unsigned int threads = cpuCount();
+    if (0.0 < m_quota)
+    {
+        threads = std::min(threads, (unsigned int) ceil(m_quota));
+    }
+    return std::max(1U, threads);
+}
+
+CpuSlot Topology::slot(unsigned int worker) const
+{
+    if (m_order.empty())
+    {
+        CpuSlot unknown = {-1, 0};
+        return unknown;
+    }
+    return m_order[worker % m_order.size()];
+}
@@ -0,0 +1,45 @@
+/*
+ * Topology.h
+ *
+ *  Which CPUs this process may run on, which NUMA node each belongs to, and
+ *  how many of them the cgroup CPU quota actually pays for. Read straight
+ *  from /proc and /sys, so there is no libnuma to link; anywhere that isn't
+ *  Linux it falls back to hardware_concurrency() and a single node.
+ */
+
+#ifndef TOPOLOGY_H_
+#define TOPOLOGY_H_
+
+#include <vector>
+
+/* Where one worker runs */
+struct CpuSlot
+{
+    int cpu;            // -1 when placement isn't known
+    unsigned int node;
+};
+
+class Topology
+{
+public:
+    Topology();
+
+    /* CPUs in the affinity mask, capped by the cgroup quota, at least one */
+    unsigned int defaultThreads() const;
+    unsigned int cpuCount() const;
+    unsigned int nodeCount() const;
+
+    /* The CPU for the worker'th worker: one per physical core before any
+        hyperthread siblings, spread across the nodes in turn */
+    CpuSlot slot(unsigned int worker) const;
+
+    /* Binds the calling thread to a single CPU, false if that isn't possible */
+    static bool pin(int cpu);
+
+private:
+    std::vector<CpuSlot> m_order;
+    unsigned int m_nodes;
+    double m_quota;  // CPUs' worth of time the cgroup allows, 0 for no limit
+};
+
+#endif /* TOPOLOGY_H_ */
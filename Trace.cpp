@@ -0,0 +1,171 @@
+/*
+ * Trace.cpp
+ *
+ *  Per-thread ring buffers of trace spans, and the JSON writer for them.
+ */
+
+#include "Trace.h"
+
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <vector>
+
+/* One thread's events, only ever written by that thread */
+struct TraceBuffer
+{
+    unsigned int tid;
+    std::string threadName;
+    std::vector<TraceEvent> events;
+    uint64_t written;  // Events recorded, including the ones since overwritten
+};
+
+static bool isTracing = false;
+static std::chrono::steady_clock::time_point epoch;
+static std::mutex registryLock;                 // Taken once per thread, and for intern()
+static std::vector<TraceBuffer*> buffers;
+static std::set<std::string> strings;
+static thread_local TraceBuffer *threadBuffer = NULL;
+
+/* The calling thread's buffer, created the first time it records */
+static TraceBuffer* ThreadBuffer()
+{
+    if (threadBuffer == NULL)
+    {
+        std::lock_guard<std::mutex> lock(registryLock);
+        threadBuffer = new TraceBuffer;
+        threadBuffer->tid = buffers.size();
+        threadBuffer->events.resize(TRACE_BUFFER_SIZE);
+        threadBuffer->written = 0;
+        buffers.push_back(threadBuffer);
+    }
+    return threadBuffer;
+}
+
+void Trace::enable()
+{
+    epoch = std::chrono::steady_clock::now();
+    isTracing = true;
+}
+
+bool Trace::isEnabled()
+{
+    return isTracing;
+}
+
+void Trace::nameThread(const std::string& name)
+{
+    if (isTracing)
+    {
+        ThreadBuffer()->threadName = name;
+    }
+}
+
+const char* Trace::intern(const std::string& text)
+{
+    std::lock_guard<std::mutex> lock(registryLock);
+    return strings.insert(text).first->c_str();
+}
+
+uint64_t Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Trace::record(const TraceEvent& event)
+{
+    TraceBuffer *buffer = ThreadBuffer();
+    buffer->events[buffer->written % TRACE_BUFFER_SIZE] = event;
+    buffer->written++;
+}
+
+/* Chrome wants microseconds */
+static double Microseconds(uint64_t nanoseconds)
+{
+    return (double) nanoseconds / 1000.0;
+}
+
+bool Trace::write(const std::string& path)
+{
+    std::ofstream out(path.c_str());
+    out.setf(std::ios::fixed);
+    out.precision(3);
+    out << "{\"traceEvents\": [\n";
+    const char *separator = "";
+    uint64_t dropped = 0;
+    for (unsigned int index = 0; index < buffers.size(); ++index)
+    {
+        const TraceBuffer *buffer = buffers[index];
+        if (!buffer->threadName.empty())
+        {
+            out << separator << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->tid
+                << ", \"args\": {\"name\": \"" << buffer->threadName << "\"}}";
+            separator = ",\n";
+        }
+
+        uint64_t first = (TRACE_BUFFER_SIZE < buffer->written) ? buffer->written - TRACE_BUFFER_SIZE : 0;
+        dropped += first;
+        for (uint64_t position = first; position < buffer->written; ++position)
+        {
+            const TraceEvent& event = buffer->events[position % TRACE_BUFFER_SIZE];
+            out << separator << "{\"name\": \"" << event.name << "\", \"cat\": \"" << event.category
+                << "\", \"ph\": \"X\", \"ts\": " << Microseconds(event.start) << ", \"dur\": " << Microseconds(event.duration)
+                << ", \"pid\": 1, \"tid\": " << buffer->tid << ", \"args\": {";
+            const char *argSeparator = "";
+            if (event.label != NULL)
+            {
+                out << "\"label\": \"" << event.label << "\"";
+                argSeparator = ", ";
+            }
+            for (unsigned int arg = 0; arg < event.argCount; ++arg)
+            {
+                out << argSeparator << "\"" << event.keys[arg] << "\": " << event.values[arg];
+                argSeparator = ", ";
+            }
+            out << "}}";
+            separator = ",\n";
+        }
+    }
+    out << "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"droppedEvents\": " << dropped << "}}\n";
+    return (bool) out;
+}
+
+TraceSpan::TraceSpan(const char *name, const char *category) : m_isEnabled(isTracing)
+{
+    if (m_isEnabled)
+    {
+        m_event.name = name;
+        m_event.category = category;
+        m_event.label = NULL;
+        m_event.argCount = 0;
+        m_event.start = Trace::now();
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (m_isEnabled)
+    {
+        m_event.duration = Trace::now() - m_event.start;
+        Trace::record(m_event);
+    }
+}
+
+void TraceSpan::arg(const char *key, uint64_t value)
+{
+    if (m_isEnabled && m_event.argCount < 2)
+    {
+        m_event.keys[m_event.argCount] = key;
+        m_event.values[m_event.argCount] = value;
+        m_event.argCount++;
+    }
+}
+
+void TraceSpan::label(const char *text)
+{
+    if (m_isEnabled)
+    {
+        m_event.label = text;
+    }
+}
@@ -0,0 +1,70 @@
+/*
+ * Trace.h
+ *
+ *  An optional timeline of where a run spends its time, written as Chrome
+ *  trace-event JSON (load it in chrome://tracing or ui.perfetto.dev). Each
+ *  thread records complete spans into a ring buffer of its own, so recording
+ *  takes no lock; the buffers are only read once every thread has been
+ *  joined. When tracing is off, a span costs one branch.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+#include <string>
+
+/* Events each thread keeps, the oldest are overwritten past this */
+static const uint32_t TRACE_BUFFER_SIZE = 32768;
+
+struct TraceEvent
+{
+    const char *name;
+    const char *category;
+    const char *label;          // Optional string argument, must outlive the trace (see Trace::intern)
+    uint64_t start;             // Nanoseconds since the trace was enabled
+    uint64_t duration;
+    unsigned int argCount;
+    const char *keys[2];
+    uint64_t values[2];
+};
+
+class Trace
+{
+public:
+    /* Call before any thread that records is started */
+    static void enable();
+    static bool isEnabled();
+
+    /* Shown as the calling thread's name in the viewer */
+    static void nameThread(const std::string& name);
+
+    /* A copy of text that lives as long as the trace, for span labels */
+    static const char* intern(const std::string& text);
+
+    static uint64_t now();
+    static void record(const TraceEvent& event);
+
+    /* Only once every recording thread has been joined */
+    static bool write(const std::string& path);
+};
+
+/* Records the time from its construction to its destruction */
+class TraceSpan
+{
+public:
+    TraceSpan(const char *name, const char *category);
+    ~TraceSpan();
+
+    void arg(const char *key, uint64_t value);
+    void label(const char *text);
+
+private:
+    TraceSpan(const TraceSpan&);
+    TraceSpan& operator=(const TraceSpan&);
+
+    bool m_isEnabled;
+    TraceEvent m_event;
+};
+
+#endif /* TRACE_H_ */
@@ -0,0 +1,345 @@
+/*
+ * bench.cpp
+ *
+ *  Microbenchmarks for each PRNG: seeding alone, seeding and one output,
+ *  seeding and a full depth through every filter kernel variant the CPU
+ *  supports, predictForward(), and one classic and one sliding inference
+ *  pass at a few observation counts. Results go to stdout as a table and,
+ *  with -j, to a JSON file with one result per line, to diff between builds.
+ *
+ *  Build with "make bench" from the top of the tree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "../ConsoleColors.h"
+#include "../PRNGFactory.h"
+
+using std::chrono::steady_clock;
+
+/* One measured case: per-item cost, and how many outputs each item generates */
+struct BenchResult
+{
+    std::string engine;
+    std::string variant;    // Kernel variant, or "virtual" for the PRNG class
+    std::string name;       // What was measured
+    uint32_t parameter;     // Depth, or observation count, 0 where it doesn't apply
+    double nanoseconds;     // Per item (seed, output or window), best of BENCH_REPEATS
+    double outputsPerItem;
+};
+
+/* Something to time, run for items items */
+typedef void (*BenchCase)(const std::string& engine, const std::string& variant, uint32_t parameter, uint64_t items);
+
+static const unsigned int BENCH_REPEATS = 3;
+static const uint32_t PREDICTION_LENGTH = 4096;
+static volatile uint32_t sink;  // Stops the compiler dropping the work being timed
+static double minimumSeconds = 0.1;
+
+/* Keeps the generator's state live without reading any output from it */
+template<typename T> inline void Clobber(T *value)
+{
+    asm volatile("" : : "r"(value) : "memory");
+}
+
+template<typename Kernel> void SeedOnly(uint64_t items)
+{
+    Kernel generator;
+    for (uint64_t seed = 0; seed < items; ++seed)
+    {
+        generator.seed((uint32_t) seed);
+        Clobber(&generator);
+    }
+}
+
+template<typename Kernel> void SeedFirst(uint64_t items)
+{
+    Kernel generator;
+    uint32_t sum = 0;
+    for (uint64_t seed = 0; seed < items; ++seed)
+    {
+        generator.seed((uint32_t) seed);
+        sum += generator.random();
+    }
+    sink = sum;
+}
+
+/* The inline kernels are distinct types, so pick one by name */
+void SeedOnlyCase(const std::string& engine, const std::string&, uint32_t, uint64_t items)
+{
+    if (engine == GLIBC_RAND)
+        SeedOnly<GlibcRandKernel>(items);
+    else if (engine == MT19937)
+        SeedOnly<Mt19937Kernel>(items);
+    else if (engine == RUBY_RAND)
+        SeedOnly<RubyKernel>(items);
+}
+
+void SeedFirstCase(const std::string& engine, const std::string&, uint32_t, uint64_t items)
+{
+    if (engine == GLIBC_RAND)
+        SeedFirst<GlibcRandKernel>(items);
+    else if (engine == MT19937)
+        SeedFirst<Mt19937Kernel>(items);
+    else if (engine == RUBY_RAND)
+        SeedFirst<RubyKernel>(items);
+}
+
+/* Every seed walks the full depth, nothing gets through the filter */
+void FilterCase(const std::string& engine, const std::string& variant, uint32_t depth, uint64_t items)
+{
+    PRNGFactory factory;
+    FilterKernel filter = factory.getKernel(engine, variant).filter;
+    std::vector<uint32_t> impossible(2, 0);
+    std::vector<uint32_t> survivors;
+    SearchChunk chunk = {&impossible[0], (uint32_t) impossible.size(), depth, 100.0, 0, 0, items - 1, NULL};
+    filter(chunk, &survivors);
+    sink = survivors.size();
+}
+
+/* Observed outputs of a known seed */
+std::vector<uint32_t> Sample(const std::string& engine, uint32_t count)
+{
+    PRNGFactory factory;
+    PRNG *generator = factory.getInstance(engine);
+    generator->seed(5489);
+    std::vector<uint32_t> outputs(count);
+    generator->fill(&outputs[0], count);
+    delete generator;
+    return outputs;
+}
+
+void PredictCase(const std::string& engine, const std::string&, uint32_t, uint64_t items)
+{
+    PRNGFactory factory;
+    PRNG *generator = factory.getInstance(engine);
+    std::vector<uint32_t> observed = Sample(engine, generator->getStateSize());
+    std::vector<uint32_t> predictions(PREDICTION_LENGTH);
+    for (uint64_t done = 0; done < items; done += PREDICTION_LENGTH)
+    {
+        generator->setState(observed);
+        sink = generator->predictForward(&predictions[0], (uint32_t) std::min((uint64_t) PREDICTION_LENGTH, items - done));
+    }
+    delete generator;
+}
+
+/* One classic window, as the inference workers score it: set, tune, predict the rest */
+void ClassicCase(const std::string& engine, const std::string&, uint32_t count, uint64_t items)
+{
+    PRNGFactory factory;
+    PRNG *generator = factory.getInstance(engine);
+    std::vector<uint32_t> observed = Sample(engine, count);
+    OutputSpan span(observed);
+    uint32_t stateSize = generator->getStateSize();
+    std::vector<uint32_t> predictions(count);
+    generator->setEvidence(observed);
+    for (uint64_t window = 0; window < items; ++window)
+    {
+        generator->setState(span.subspan(0, stateSize));
+        generator->tune(span.subspan(0, 0), span.subspan(stateSize + 1, count - stateSize - 1));
+        sink = generator->predictForward(&predictions[0], count - stateSize);
+    }
+    delete generator;
+}
+
+/* Every window over count observed values, in one sliding pass */
+void SlidingCase(const std::string& engine, const std::string&, uint32_t count, uint64_t items)
+{
+    PRNGFactory factory;
+    PRNG *generator = factory.getInstance(engine);
+    std::vector<uint32_t> observed = Sample(engine, count);
+    OutputSpan span(observed);
+    uint32_t stateSize = generator->getStateSize();
+    uint32_t hits = 0;
+    for (uint64_t pass = 0; pass < items; ++pass)
+    {
+        generator->beginSlide(span.subspan(0, stateSize));
+        for (uint32_t index = stateSize; index < count; ++index)
+        {
+            hits += generator->slide(observed[index]);
+        }
+    }
+    sink = hits;
+    delete generator;
+}
+
+double Seconds(BenchCase run, const std::string& engine, const std::string& variant, uint32_t parameter, uint64_t items)
+{
+    steady_clock::time_point start = steady_clock::now();
+    run(engine, variant, parameter, items);
+    return std::chrono::duration<double>(steady_clock::now() - start).count();
+}
+
+/* Double the item count until a run takes minimumSeconds, then keep the best of a few runs */
+BenchResult Measure(BenchCase run, const std::string& engine, const std::string& variant, const std::string& name,
+        uint32_t parameter, double outputsPerItem)
+{
+    uint64_t items = 1;
+    while (Seconds(run, engine, variant, parameter, items) < minimumSeconds && items < (1ULL << 32))
+    {
+        items *= 2;
+    }
+    double best = Seconds(run, engine, variant, parameter, items);
+    for (unsigned int repeat = 1; repeat < BENCH_REPEATS; ++repeat)
+    {
+        best = std::min(best, Seconds(run, engine, variant, parameter, items));
+    }
+    BenchResult result = {engine, variant, name, parameter, best * 1e9 / (double) items, outputsPerItem};
+    std::cout << INFO << engine << " " << name;
+    if (parameter != 0)
+        std::cout << " (" << parameter << ")";
+    std::cout << " [" << variant << "]: " << result.nanoseconds << " ns";
+    if (0.0 < outputsPerItem)
+        std::cout << ", " << (outputsPerItem * 1e9 / result.nanoseconds) << " outputs/s";
+    std::cout << std::endl;
+    return result;
+}
+
+void WriteJson(const std::string& path, const std::vector<BenchResult>& results)
+{
+    std::ofstream out(path.c_str());
+    out << "{\"results\": [\n";
+    for (unsigned int index = 0; index < results.size(); ++index)
+    {
+        const BenchResult& result = results[index];
+        double outputsPerSecond = result.outputsPerItem * 1e9 / result.nanoseconds;
+        out << "  {\"engine\": \"" << result.engine << "\", \"variant\": \"" << result.variant
+            << "\", \"case\": \"" << result.name << "\", \"parameter\": " << result.parameter
+            << ", \"ns\": " << result.nanoseconds << ", \"outputsPerSecond\": " << outputsPerSecond << "}"
+            << ((index + 1 < results.size()) ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    if (!out)
+    {
+        std::cerr << WARN << "ERROR: Could not write \"" << path << "\"" << std::endl;
+    }
+}
+
+void Usage()
+{
+    std::cout << BOLD << "bench" << RESET << " - Untwister PRNG and kernel microbenchmarks." << std::endl;
+    std::cout << "\t-r <prng>[,<prng>...]\n\t\tOnly benchmark these PRNGs (default all)" << std::endl;
+    std::cout << "\t-d <depth>\n\t\tDepth of the filter kernel runs (default 1000)" << std::endl;
+    std::cout << "\t-m <seconds>\n\t\tShortest run to time per case (default 0.1)" << std::endl;
+    std::cout << "\t-j <file>\n\t\tAlso write the results to this file as JSON" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    PRNGFactory factory;
+    std::vector<std::string> engines = factory.getNames();
+    uint32_t depth = 1000;
+    std::string jsonPath;
+    int c;
+    while ((c = getopt(argc, argv, "r:d:m:j:h")) != -1)
+    {
+        switch (c)
+        {
+            case 'r':
+            {
+                std::vector<std::string> names = factory.getNames();
+                engines.clear();
+                std::stringstream list(optarg);
+                std::string engine;
+                while (std::getline(list, engine, ','))
+                {
+                    if (std::find(names.begin(), names.end(), engine) == names.end())
+                    {
+                        std::cerr << WARN << "ERROR: The PRNG \"" << engine << "\" is not supported" << std::endl;
+                        return EXIT_FAILURE;
+                    }
+                    engines.push_back(engine);
+                }
+                break;
+            }
+            case 'd':
+            {
+                depth = strtoul(optarg, NULL, 10);
+                if (depth == 0)
+                {
+                    std::cerr << WARN << "ERROR: Please enter a valid depth > 1" << std::endl;
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'm':
+            {
+                minimumSeconds = ::atof(optarg);
+                break;
+            }
+            case 'j':
+            {
+                jsonPath = optarg;
+                break;
+            }
+            default:
+            {
+                Usage();
+                return (c == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+            }
+        }
+    }
+
+    std::vector<BenchResult> results;
+    std::vector<std::string> variants = factory.getVariantNames();
+    for (unsigned int index = 0; index < engines.size(); ++index)
+    {
+        const std::string& engine = engines[index];
+        PRNG *generator = factory.getInstance(engine);
+        uint32_t stateSize = generator->getStateSize();
+        delete generator;
+
+        results.push_back(Measure(&SeedOnlyCase, engine, "scalar", "seed", 0, 0.0));
+        results.push_back(Measure(&SeedFirstCase, engine, "scalar", "seed+first", 0, 1.0));
+        for (unsigned int variant = 0; variant < variants.size(); ++variant)
+        {
+            if (PRNGFactory::isVariantSupported(variants[variant]))
+            {
+                results.push_back(Measure(&FilterCase, engine, variants[variant], "seed+depth", depth, depth));
+            }
+        }
+
+        /* Some PRNGs can't predict from a classic window at all, timing them would mean nothing */
+        std::vector<uint32_t> observed = Sample(engine, stateSize);
+        uint32_t probe;
+        generator = factory.getInstance(engine);
+        generator->setState(observed);
+        bool canPredict = (generator->predictForward(&probe, 1) != 0);
+        delete generator;
+        if (canPredict)
+        {
+            results.push_back(Measure(&PredictCase, engine, "virtual", "predictForward", 0, 1.0));
+        }
+        else
+        {
+            std::cout << DEBUG << engine << " can't predict from a classic window, skipping predictForward and classic windows" << std::endl;
+        }
+
+        /* Per classic window, and per whole sliding pass, at a few observation counts */
+        uint32_t counts[] = {stateSize + 64, stateSize * 4, stateSize * 32};
+        for (unsigned int count = 0; count < sizeof(counts) / sizeof(counts[0]); ++count)
+        {
+            uint32_t relations = counts[count] - stateSize;
+            if (canPredict)
+            {
+                results.push_back(Measure(&ClassicCase, engine, "virtual", "classic window", counts[count], relations));
+            }
+            results.push_back(Measure(&SlidingCase, engine, "virtual", "sliding pass", counts[count], relations));
+        }
+    }
+
+    if (!jsonPath.empty())
+    {
+        WriteJson(jsonPath, results);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,142 @@
+#!/usr/bin/env bash
+#
+# scaling.sh
+#
+#   End-to-end scaling of untwister's brute force: thread count, depth, seed
+#   range and NUMA layout. Every run searches an input generated with -g from
+#   a planted seed, and the search time is read from the -j metrics, so the
+#   process startup and fingerprinting are left out.
+#
+#   strong   A fixed range of seeds that doesn't hold the planted seed, so it
+#            is always scanned in full, on more and more threads.
+#   weak     The same number of seeds per thread, scanned in full, on more and
+#            more threads.
+#   hit      TRIALS planted seeds at random within the weak range, searched
+#            until found, for the spread of time-to-hit.
+#
+#   Settings come from the environment (defaults in brackets):
+#     UNTWISTER    binary to run [./untwister]
+#     PRNG         PRNG to plant and search [glibc-rand]
+#     THREADS      thread counts [1 2 4 ... up to nproc]
+#     DEPTHS       search depths, each run at that depth alone since -m brute
+#                  keeps the planner from deepening [1000]
+#     SEEDS        range sizes, each the seeds per strong run and per thread in
+#                  weak runs [1048576]
+#     TRIALS       planted seeds per hit run [5]
+#     LAYOUTS      none, interleave, local or node:<n>, through numactl [none]
+#     RANDOM_SEED  makes the planted seeds reproducible [1]
+#     OUT          CSV of every run [scaling.csv]
+#
+#   e.g.  THREADS="1 2 4 8" DEPTHS="100 1000" SEEDS="65536 1048576" LAYOUTS="none interleave" bench/scaling.sh
+#
+
+set -euo pipefail
+
+UNTWISTER=${UNTWISTER:-./untwister}
+PRNG=${PRNG:-glibc-rand}
+DEPTHS=${DEPTHS:-1000}
+SEEDS=${SEEDS:-1048576}
+TRIALS=${TRIALS:-5}
+LAYOUTS=${LAYOUTS:-none}
+RANDOM_SEED=${RANDOM_SEED:-1}
+OUT=${OUT:-scaling.csv}
+if [ -z "${THREADS:-}" ]; then
+    THREADS=""
+    for ((count = 1; count <= $(nproc); count *= 2)); do
+        THREADS="$THREADS $count"
+    done
+fi
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+RANDOM=$RANDOM_SEED
+
+# Prefix that runs a command under a NUMA layout
+layout_prefix() {
+    case "$1" in
+        none) echo "" ;;
+        interleave) echo "numactl --interleave=all" ;;
+        local) echo "numactl --localalloc" ;;
+        node:*) echo "numactl --cpunodebind=${1#node:} --membind=${1#node:}" ;;
+        *) echo "Unknown layout $1" >&2; exit 1 ;;
+    esac
+}
+
+# A 30 bit random number, from bash's 15 bit $RANDOM
+random30() {
+    echo $(( (RANDOM << 15) | RANDOM ))
+}
+
+# run <kind> <layout> <depth> <range> <threads> <lower> <upper> <planted> <trial>: appends one CSV row
+run() {
+    local kind=$1 layout=$2 depth=$3 range=$4 threads=$5 lower=$6 upper=$7 planted=$8 trial=$9
+    "$UNTWISTER" -g "$planted" -d 16 -r "$PRNG" > "$WORK/sample.txt"
+    $(layout_prefix "$layout") "$UNTWISTER" -i "$WORK/sample.txt" -r "$PRNG" -m brute -t "$threads" \
+        -d "$depth" -a "$lower:$upper" -j "$WORK/metrics.json" > "$WORK/output.txt"
+    local seconds
+    seconds=$(sed -n 's/^  "seconds": \([0-9.e+-]*\),$/\1/p' "$WORK/metrics.json")
+    local found=0
+    if grep -q "Found seed $planted " "$WORK/output.txt"; then
+        found=1
+    fi
+    echo "$kind,$layout,$PRNG,$depth,$range,$threads,$((upper - lower + 1)),$trial,$found,$seconds" >> "$OUT"
+}
+
+echo "kind,layout,prng,depth,range,threads,seeds,trial,found,seconds" > "$OUT"
+for layout in $LAYOUTS; do
+    if [ "$layout" != none ] && ! command -v numactl > /dev/null; then
+        echo "numactl is not installed, skipping the $layout layout" >&2
+        continue
+    fi
+    for depth in $DEPTHS; do
+        for range in $SEEDS; do
+            for threads in $THREADS; do
+                echo "layout $layout, depth $depth, $range seed(s), $threads thread(s)" >&2
+                # The planted seed sits just past the range, so it is never found and the range is scanned in full
+                run strong "$layout" "$depth" "$range" "$threads" 0 $((range - 1)) $((range + 1)) 0
+                run weak "$layout" "$depth" "$range" "$threads" 0 $((range * threads - 1)) $((range * threads + 1)) 0
+                for ((trial = 0; trial < TRIALS; trial++)); do
+                    run hit "$layout" "$depth" "$range" "$threads" 0 $((range * threads - 1)) \
+                        $(( 1 + $(random30) % (range * threads - 1) )) "$trial"
+                done
+            done
+        done
+    done
+done
+
+# Efficiencies against the first (smallest) thread count of each group, and the time-to-hit spread
+printf "%-6s %-10s %6s %10s %8s\n" run layout depth range threads
+sort -t, -k1,1 -k2,2 -k4,4n -k5,5n -k6,6n -k10,10g "$OUT" | awk -F, '
+    $1 == "kind" { next }
+    function flush_hits() {
+        if (hits == 0) return
+        printf "%-6s %-10s %6d %10d %8d  min %.3fs  median %.3fs  p90 %.3fs  max %.3fs  found %d/%d\n", "hit", hitLayout,
+            hitDepth, hitRange, hitThreads, times[1], times[int((hits + 1) / 2)], times[int(hits * 0.9 + 0.999)], times[hits],
+            found, hits
+        hits = 0
+        found = 0
+    }
+    {
+        key = $1 "," $2 "," $4 "," $5 "," $6
+        if (key != lastKey) flush_hits()
+        lastKey = key
+    }
+    $1 == "strong" || $1 == "weak" {
+        group = $1 "," $2 "," $4 "," $5
+        if (!(group in base)) { base[group] = $10; baseThreads[group] = $6 }
+        efficiency = base[group] / $10
+        if ($1 == "strong") efficiency *= baseThreads[group] / $6
+        printf "%-6s %-10s %6d %10d %8d  %.3fs  %.0f seeds/s  efficiency %.1f%%\n", $1, $2, $4, $5, $6, $10, $7 / $10,
+            efficiency * 100
+    }
+    $1 == "hit" {
+        times[++hits] = $10
+        found += $9
+        hitLayout = $2
+        hitDepth = $4
+        hitRange = $5
+        hitThreads = $6
+    }
+    END { flush_hits() }
+'
+echo "Every run is in $OUT" >&2
@@ -0,0 +1,328 @@
+/*
+ * verify.cpp
+ *
+ *  Differential check of every fast path against a reference engine that
+ *  shares no code with it: libc's own random_r() for glibc-rand, and
+ *  std::mt19937 for mt19937 and ruby-rand (whose rand() here is MT19937
+ *  seeded with init_genrand()). On random seeds, depths and block splits it
+ *  compares the PRNG classes, the inline kernels, every filter kernel
+ *  variant the CPU supports and the verifier, then reports how much faster
+ *  each filter variant is than the scalar one. Exits non-zero after any
+ *  mismatch, so "make verify" fails when a fast path diverges.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+
+#include "../ConsoleColors.h"
+#include "../PRNGFactory.h"
+
+/* The engine everything else is checked against */
+class Reference
+{
+public:
+    virtual void seed(uint32_t) = 0;
+    virtual uint32_t random(void) = 0;
+    virtual ~Reference() {}
+};
+
+class LibcReference: public Reference
+{
+public:
+    void seed(uint32_t value)
+    {
+        memset(&m_data, 0, sizeof(m_data));
+        initstate_r(value, m_state, sizeof(m_state), &m_data);  // 128 bytes of state is TYPE_3
+    }
+
+    uint32_t random(void)
+    {
+        int32_t value;
+        random_r(&m_data, &value);
+        return (uint32_t) value;
+    }
+
+private:
+    struct random_data m_data;
+    char m_state[128];
+};
+
+class MtReference: public Reference
+{
+public:
+    void seed(uint32_t value)
+    {
+        m_engine.seed(value);
+    }
+
+    uint32_t random(void)
+    {
+        return (uint32_t) m_engine();
+    }
+
+private:
+    std::mt19937 m_engine;
+};
+
+static const uint32_t MAX_DEPTH = 2000;
+static const uint32_t MAX_CHUNK = 100;
+static unsigned int failures = 0;
+static std::mt19937_64 dice;
+
+uint32_t Roll(uint32_t lower, uint32_t upper)
+{
+    return std::uniform_int_distribution<uint32_t>(lower, upper)(dice);
+}
+
+/* A few awkward seeds, then random ones */
+uint32_t PickSeed(unsigned int round)
+{
+    const uint32_t edges[] = {0, 1, 2147483647U, 2147483648U, 4294967295U};
+    return (round < sizeof(edges) / sizeof(edges[0])) ? edges[round] : (uint32_t) dice();
+}
+
+std::vector<uint32_t> ReferenceOutputs(Reference *reference, uint32_t seed, uint32_t count)
+{
+    std::vector<uint32_t> outputs(count);
+    reference->seed(seed);
+    for (uint32_t index = 0; index < count; ++index)
+    {
+        outputs[index] = reference->random();
+    }
+    return outputs;
+}
+
+void Mismatch(const std::string& engine, const std::string& what, uint32_t seed, uint32_t position)
+{
+    if (failures++ < 10)
+    {
+        std::cout << WARN << engine << ": " << what << " differs from the reference for seed " << seed
+                  << " at output " << position << std::endl;
+    }
+}
+
+void Compare(const std::string& engine, const std::string& what, uint32_t seed,
+        const std::vector<uint32_t>& expected, const std::vector<uint32_t>& actual)
+{
+    for (uint32_t index = 0; index < expected.size(); ++index)
+    {
+        if (expected[index] != actual[index])
+        {
+            Mismatch(engine, what, seed, index);
+            return;
+        }
+    }
+}
+
+/* fill() in random sized pieces, so pieces end everywhere relative to the engine's own blocks */
+template<typename Generator> std::vector<uint32_t> FillInPieces(Generator *generator, uint32_t count)
+{
+    std::vector<uint32_t> outputs(count);
+    for (uint32_t done = 0; done < count; )
+    {
+        uint32_t piece = std::min(count - done, Roll(1, 700));
+        generator->fill(&outputs[done], piece);
+        done += piece;
+    }
+    return outputs;
+}
+
+template<typename Kernel> std::vector<uint32_t> KernelOutputs(uint32_t seed, uint32_t count)
+{
+    Kernel generator;
+    generator.seed(seed);
+    return FillInPieces(&generator, count);
+}
+
+/* The inline kernels are distinct types, so pick one by name */
+std::vector<uint32_t> KernelOutputs(const std::string& engine, uint32_t seed, uint32_t count)
+{
+    if (engine == GLIBC_RAND)
+        return KernelOutputs<GlibcRandKernel>(seed, count);
+    if (engine == MT19937)
+        return KernelOutputs<Mt19937Kernel>(seed, count);
+    return KernelOutputs<RubyKernel>(seed, count);
+}
+
+void CheckStreams(const std::string& engine, Reference *reference, unsigned int rounds)
+{
+    PRNGFactory factory;
+    PRNG *generator = factory.getInstance(engine);
+    for (unsigned int round = 0; round < rounds; ++round)
+    {
+        uint32_t seed = PickSeed(round);
+        uint32_t count = Roll(1, MAX_DEPTH);
+        std::vector<uint32_t> expected = ReferenceOutputs(reference, seed, count);
+
+        std::vector<uint32_t> actual(count);
+        generator->seed(seed);
+        for (uint32_t index = 0; index < count; ++index)
+        {
+            actual[index] = generator->random();
+        }
+        Compare(engine, "PRNG::random()", seed, expected, actual);
+
+        generator->seed(seed);
+        Compare(engine, "PRNG::fill()", seed, expected, FillInPieces(generator, count));
+        Compare(engine, "the inline kernel", seed, expected, KernelOutputs(engine, seed, count));
+    }
+    delete generator;
+}
+
+/* Every variant must let through exactly the seeds whose first depth reference outputs hold observed[0] */
+void CheckFilters(const std::string& engine, Reference *reference, unsigned int rounds)
+{
+    PRNGFactory factory;
+    std::vector<std::string> variants = factory.getVariantNames();
+    for (unsigned int round = 0; round < rounds; ++round)
+    {
+        uint32_t seedCount = Roll(1, MAX_CHUNK);
+        uint32_t firstSeed = (round % 4 == 0) ? 4294967295U - (seedCount - 1) : Roll(0, 4294967295U - (seedCount - 1));
+        uint32_t depth = Roll(1, MAX_DEPTH);
+
+        /* Plant a value from one of the seeds, sometimes just past the depth */
+        uint32_t planted = firstSeed + Roll(0, seedCount - 1);
+        uint32_t position = (round % 3 == 0) ? depth : Roll(0, depth - 1);
+        std::vector<uint32_t> observed(2, ReferenceOutputs(reference, planted, position + 1)[position]);
+
+        std::vector<uint32_t> expected;
+        for (uint32_t index = 0; index < seedCount; ++index)
+        {
+            std::vector<uint32_t> outputs = ReferenceOutputs(reference, firstSeed + index, depth);
+            if (std::find(outputs.begin(), outputs.end(), observed[0]) != outputs.end())
+            {
+                expected.push_back(firstSeed + index);
+            }
+        }
+
+        SearchChunk chunk = {&observed[0], (uint32_t) observed.size(), depth, 100.0, 0, firstSeed,
+                             (uint64_t) firstSeed + seedCount - 1, NULL};
+        for (unsigned int variant = 0; variant < variants.size(); ++variant)
+        {
+            if (!PRNGFactory::isVariantSupported(variants[variant]))
+            {
+                continue;
+            }
+            std::vector<uint32_t> survivors;
+            factory.getKernel(engine, variants[variant]).filter(chunk, &survivors);
+            std::sort(survivors.begin(), survivors.end());
+            if (survivors != expected && failures++ < 10)
+            {
+                std::cout << WARN << engine << ": the " << variants[variant] << " filter let " << survivors.size()
+                          << " seed(s) through instead of " << expected.size() << " (seeds " << firstSeed << " to "
+                          << (uint64_t) firstSeed + seedCount - 1 << ", depth " << depth << ")" << std::endl;
+            }
+        }
+    }
+}
+
+/* The verifier must find a seed from any run of its reference outputs that fits within the depth */
+void CheckVerifier(const std::string& engine, Reference *reference, unsigned int rounds)
+{
+    PRNGFactory factory;
+    SearchKernel verifier = factory.getVerifier(engine);
+    for (unsigned int round = 0; round < rounds; ++round)
+    {
+        uint32_t seed = PickSeed(round);
+        uint32_t depth = Roll(2, MAX_DEPTH);
+        uint32_t length = Roll(1, std::min(depth, (uint32_t) 100));
+        uint32_t offset = Roll(0, depth - length);
+        std::vector<uint32_t> outputs = ReferenceOutputs(reference, seed, depth);
+        std::vector<uint32_t> observed(outputs.begin() + offset, outputs.begin() + offset + length);
+
+        std::vector<Seed> answers;
+        SearchChunk chunk = {&observed[0], length, depth, 100.0, 0, seed, seed, NULL};
+        uint32_t firstMatch = std::find(outputs.begin(), outputs.end(), observed[0]) - outputs.begin();
+        if (!verifier(chunk, &answers) || answers.size() != 1 || answers[0].value != seed)
+        {
+            Mismatch(engine, "the verifier", seed, offset);
+        }
+        else if (answers[0].offset != firstMatch)
+        {
+            Mismatch(engine, "the verifier's match offset", seed, offset);
+        }
+    }
+}
+
+void ReportSpeedups(const std::string& engine)
+{
+    PRNGFactory factory;
+    std::vector<std::string> variants = factory.getVariantNames();
+    std::vector<uint32_t> impossible(2, 0);
+    SearchChunk chunk = {&impossible[0], 2, 1000, 100.0, 0, 0, 4095, NULL};
+    double scalarSeconds = 0.0;
+    for (unsigned int variant = 0; variant < variants.size(); ++variant)
+    {
+        if (!PRNGFactory::isVariantSupported(variants[variant]))
+        {
+            continue;
+        }
+        std::vector<uint32_t> survivors;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        factory.getKernel(engine, variants[variant]).filter(chunk, &survivors);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (variant == 0)
+        {
+            scalarSeconds = seconds;
+        }
+        std::cout << DEBUG << engine << " " << variants[variant] << " filter: " << (scalarSeconds / seconds)
+                  << "x the scalar speed" << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned int rounds = 200;
+    uint64_t diceSeed = 1;
+    int c;
+    while ((c = getopt(argc, argv, "n:s:h")) != -1)
+    {
+        switch (c)
+        {
+            case 'n':
+                rounds = strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                diceSeed = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                std::cout << "verify [-n <rounds>] [-s <seed for the random cases>]" << std::endl;
+                return (c == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    dice.seed(diceSeed);
+
+    PRNGFactory factory;
+    std::vector<std::string> engines = factory.getNames();
+    LibcReference libc;
+    MtReference mt;
+    for (unsigned int index = 0; index < engines.size(); ++index)
+    {
+        const std::string& engine = engines[index];
+        Reference *reference = (engine == GLIBC_RAND) ? (Reference*) &libc : (Reference*) &mt;
+        unsigned int before = failures;
+        CheckStreams(engine, reference, rounds);
+        CheckFilters(engine, reference, rounds);
+        CheckVerifier(engine, reference, rounds);
+        if (failures == before)
+        {
+            std::cout << SUCCESS << engine << " matches its reference in " << rounds << " round(s) of each check" << std::endl;
+        }
+        ReportSpeedups(engine);
+    }
+
+    if (failures != 0)
+    {
+        std::cout << WARN << "ERROR: " << failures << " mismatch(es)" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
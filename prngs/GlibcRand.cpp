@@ -36,7 +36,7 @@ const std::string GlibcRand::getName()
 void GlibcRand::seed(uint32_t value)
 {
     seedValue = value;
-    srand(value);
+    m_kernel.seed(value);
 }
 
 uint32_t GlibcRand::getSeed()
@@ -46,7 +46,12 @@ uint32_t GlibcRand::getSeed()
 
 uint32_t GlibcRand::random()
 {
-    return rand();
+    return m_kernel.random();
+}
+
+void GlibcRand::fill(uint32_t *out, uint32_t length)
+{
+    m_kernel.fill(out, length);
 }
 
 uint32_t GlibcRand::getStateSize(void)
@@ -54,9 +59,9 @@ uint32_t GlibcRand::getStateSize(void)
     return GLIBC_RAND_STATE_SIZE;
 }
 
-void GlibcRand::setState(std::vector<uint32_t> inState)
+void GlibcRand::setState(OutputSpan inState)
 {
-    m_state = inState;
+    m_state.assign(inState.begin(), inState.end());
     m_state.resize(GLIBC_RAND_STATE_SIZE, 0);
 
     /* Shift left one bit to return to mod 2^32.
@@ -68,56 +73,47 @@ void GlibcRand::setState(std::vector<uint32_t> inState)
     }
 }
 
-std::vector<uint32_t> GlibcRand::getState(void)
+OutputSpan GlibcRand::getState(void)
 {
-    return m_state;
+    return OutputSpan(m_state);
 }
 
-void GlibcRand::setEvidence(std::vector<uint32_t> evidence)
+void GlibcRand::setEvidence(OutputSpan evidence)
 {
     m_evidence = evidence;
 }
 
-std::vector<uint32_t> GlibcRand::predictForward(uint32_t length)
+/* Only the last 32 state words are ever needed, so run the recurrence in a ring */
+uint32_t GlibcRand::predictForward(uint32_t *out, uint32_t length)
 {
-    std::vector<uint32_t> running_state = m_state;
-    running_state.resize(GLIBC_RAND_STATE_SIZE + length);
-
-    std::vector<uint32_t> ret;
-    
-    /* There is a more memory efficient way to do this. With a 
-        linked list for the state. But meh.  */
-    for(uint32_t i = 32; i < length + 32; i++)
+    uint32_t ring[GLIBC_RAND_STATE_SIZE];
+    std::copy(m_state.begin(), m_state.end(), ring);
+
+    for(uint32_t i = GLIBC_RAND_STATE_SIZE; i < length + GLIBC_RAND_STATE_SIZE; i++)
     {
-        uint32_t val = running_state[i-31] + running_state[i-3];
-        running_state[i] = val;
-        ret.push_back((val >> 1) & 0x7fffffff);
+        uint32_t val = ring[(i-31) & 31] + ring[(i-3) & 31];
+        ring[i & 31] = val;
+        out[i - GLIBC_RAND_STATE_SIZE] = (val >> 1) & 0x7fffffff;
     }
 
-    return ret;
+    return length;
 }
 
-std::vector<uint32_t> GlibcRand::predictBackward(uint32_t length)
+/* Same as predictForward(), but walking the state in reverse. The predictions
+    are written back to front, so out[] ends up in output order. */
+uint32_t GlibcRand::predictBackward(uint32_t *out, uint32_t length)
 {
-    std::vector<uint32_t> running_state = m_state;
-    /* Reverse order for simplicity. Deal with it. */
-    std::reverse(running_state.begin(), running_state.end());
-    running_state.resize(GLIBC_RAND_STATE_SIZE + length);
-
-    std::vector<uint32_t> ret;
-    
-    /* There is a more memory efficient way to do this. With a 
-        linked list for the state. But meh.  */
+    uint32_t ring[GLIBC_RAND_STATE_SIZE];
+    std::reverse_copy(m_state.begin(), m_state.end(), ring);
+
     for(uint32_t i = GLIBC_RAND_STATE_SIZE; i < length + GLIBC_RAND_STATE_SIZE; i++)
     {
-        uint32_t val = running_state[i-31] - running_state[i-28];
-        running_state[i] = val;
-        ret.push_back((val >> 1) & 0x7fffffff);
+        uint32_t val = ring[(i-31) & 31] - ring[(i-28) & 31];
+        ring[i & 31] = val;
+        out[length - 1 - (i - GLIBC_RAND_STATE_SIZE)] = (val >> 1) & 0x7fffffff;
     }
 
-    /* Reverse order for simplicity. Deal with it. */
-    std::reverse(ret.begin(), ret.end());
-    return ret;
+    return length;
 }
 
 /* We just have to make some guesses about the LSBs and then test those 
@@ -135,7 +131,9 @@ void GlibcRand::tune_repeatedIncrements()
         for(uint32_t i = 0; i < GLIBC_RAND_STATE_SIZE; i++)
         {
             /* Get the success rate of this state */
-            std::vector<uint32_t> guesses = this->predictForward(m_evidence.size() - GLIBC_RAND_STATE_SIZE);
+            std::vector<uint32_t>& guesses = m_guesses;
+            guesses.resize(m_evidence.size() - GLIBC_RAND_STATE_SIZE);
+            this->predictForward(&guesses[0], guesses.size());
 
             uint64_t sum = 0;
             for(uint32_t j = 0; j < guesses.size(); j++)
@@ -144,11 +142,12 @@ void GlibcRand::tune_repeatedIncrements()
                     m_evidence[GLIBC_RAND_STATE_SIZE + j] - guesses[j]);
             }
 
-            //Increment the state val
+            //Increment the state val, keeping a snapshot to roll back to
+            saveSnapshot(m_snapshot);
             m_state[i] += 1;
             
             /* Get the success rate of the new state */
-            guesses = this->predictForward(m_evidence.size() - GLIBC_RAND_STATE_SIZE);
+            this->predictForward(&guesses[0], guesses.size());
 
             uint64_t sum_new = 0;
             for(uint32_t j = 0; j < guesses.size(); j++)
@@ -163,7 +162,7 @@ void GlibcRand::tune_repeatedIncrements()
                     m_evidence[GLIBC_RAND_STATE_SIZE + j] - guesses[j]);
             }
 
-            m_state[i] -= 1;
+            restoreSnapshot(m_snapshot);
             if(sum_new < sum)
             {
                 setLSB(i, 1);
@@ -246,7 +245,7 @@ void GlibcRand::setLSBor(uint32_t index1, uint32_t index2)
     }    
 }
 
-bool GlibcRand::handleRemainder(uint32_t i, std::vector<uint32_t> guesses)
+bool GlibcRand::handleRemainder(uint32_t i, const std::vector<uint32_t>& guesses)
 {
     /* Did we learn any new information? */
     bool ret = false;
@@ -317,7 +316,9 @@ void GlibcRand::tune_chainChecking()
     while(keepGoing)
     {
         keepGoing = false;
-        std::vector<uint32_t> guesses = this->predictForward(m_evidence.size() - GLIBC_RAND_STATE_SIZE);
+        std::vector<uint32_t>& guesses = m_guesses;
+        guesses.resize(m_evidence.size() - GLIBC_RAND_STATE_SIZE);
+        this->predictForward(&guesses[0], guesses.size());
         m_LSBMap.resize(GLIBC_RAND_STATE_SIZE + guesses.size());
 
         for(uint32_t i = 0; i < guesses.size()-3; i++)
@@ -376,12 +377,92 @@ bool GlibcRand::reverseToSeed(uint32_t *outSeed, uint32_t depth)
     return false;
 }
 
+/* Outputs are 31 bits wide, and since the LSB of the state is dropped
+    o[i] = o[i-3] + o[i-31] mod 2^31, give or take the lost carry of 1 */
+Fingerprint GlibcRand::fingerprint(OutputSpan observed)
+{
+    Fingerprint result = {0, 0};
+    for (uint32_t index = 0; index < observed.size(); ++index)
+    {
+        result.tested++;
+        if (observed[index] <= 0x7fffffff)
+        {
+            result.satisfied++;
+        }
+
+        if (index < GLIBC_RAND_STATE_SIZE - 1)
+        {
+            continue;
+        }
+        uint32_t carry = (observed[index] - observed[index - 3] - observed[index - 31]) & 0x7fffffff;
+        result.tested++;
+        if (carry <= 1)
+        {
+            result.satisfied++;
+        }
+    }
+    return result;
+}
+
+void GlibcRand::beginSlide(OutputSpan window)
+{
+    std::copy(window.begin(), window.begin() + GLIBC_RAND_STATE_SIZE, m_window);
+    m_windowIndex = GLIBC_RAND_STATE_SIZE;
+}
+
+/* Without the LSBs the window can only predict the next output up to the
+    lost carry, so a prediction holds if it's off by 0 or 1 */
+bool GlibcRand::slide(uint32_t next)
+{
+    uint32_t expected = m_window[(m_windowIndex - 3) & 31] + m_window[(m_windowIndex - 31) & 31];
+    m_window[m_windowIndex & 31] = next;
+    m_windowIndex++;
+    return next <= 0x7fffffff && ((next - expected) & 0x7fffffff) <= 1;
+}
+
 /* In glibc-rand, the rand() function chops off the LSB of the computed value. 
     This makes reversing it annoying, but not impossible. */
-void GlibcRand::tune(std::vector<uint32_t> evidenceForward, std::vector<uint32_t> evidenceBackward)
+void GlibcRand::tune(OutputSpan evidenceForward, OutputSpan evidenceBackward)
 {
     tune_chainChecking();
     //tune_fuzzyGuessing();
     tune_repeatedIncrements();
 }
 
+/* The 32 state words, then which of their LSBs are known and what those LSBs are.
+    That is all a restore rolls back: the xor/or relations recorded between
+    still unknown LSBs, and anything learnt about the LSBs of the outputs past
+    the first 32, are kept as they are. tune() only branches on the state words. */
+uint32_t GlibcRand::getSnapshotSize(void)
+{
+    return GLIBC_RAND_SNAPSHOT_SIZE;
+}
+
+void GlibcRand::saveSnapshot(uint32_t *out)
+{
+    std::copy(m_state.begin(), m_state.end(), out);
+    uint32_t known = 0;
+    uint32_t lsbs = 0;
+    for(uint32_t i = 0; i < GLIBC_RAND_STATE_SIZE; i++)
+    {
+        known |= (m_LSBMap[i].m_isKnown ? 1U : 0U) << i;
+        lsbs |= (m_LSBMap[i].m_LSB & 1) << i;
+    }
+    out[GLIBC_RAND_STATE_SIZE] = known;
+    out[GLIBC_RAND_STATE_SIZE + 1] = lsbs;
+}
+
+void GlibcRand::restoreSnapshot(const uint32_t *in)
+{
+    m_state.assign(in, in + GLIBC_RAND_STATE_SIZE);
+    for(uint32_t i = 0; i < GLIBC_RAND_STATE_SIZE; i++)
+    {
+        m_LSBMap[i].m_isKnown = (in[GLIBC_RAND_STATE_SIZE] >> i) & 1;
+        m_LSBMap[i].m_LSB = (in[GLIBC_RAND_STATE_SIZE + 1] >> i) & 1;
+    }
+}
+
+PRNG* GlibcRand::clone(void)
+{
+    return new GlibcRand(*this);
+}
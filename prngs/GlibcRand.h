@@ -15,6 +15,151 @@
 
 static const std::string GLIBC_RAND = "glibc-rand";
 static const uint32_t GLIBC_RAND_STATE_SIZE = 32;
+static const uint32_t GLIBC_RAND_DISCARD = 310;
+static const uint32_t GLIBC_RAND_SNAPSHOT_SIZE = GLIBC_RAND_STATE_SIZE + 2;
+
+/*
+    Inline, non-virtual glibc random_r() (TYPE_3: degree 31, separation 3) for
+    the brute force hot loop. Outputs are r[i] >> 1 for
+        r[i] = r[i-31] + r[i-3]
+    kept in a 32 entry ring, so r[i-31] and r[i-3] sit at (i+1) and (i+29) mod 32.
+*/
+class GlibcRandKernel
+{
+public:
+    inline void seed(uint32_t value)
+    {
+        /* Same as srandom_r(), including the signed arithmetic for seeds >= 2^31 */
+        int32_t word = (value == 0) ? 1 : (int32_t) value;
+        m_ring[0] = word;
+        for (uint32_t index = 1; index < GLIBC_RAND_STATE_SIZE - 1; ++index)
+        {
+            int32_t hi = word / 127773;
+            int32_t lo = word % 127773;
+            word = 16807 * lo - 2836 * hi;
+            if (word < 0)
+            {
+                word += 2147483647;
+            }
+            m_ring[index] = word;
+        }
+        for (uint32_t index = GLIBC_RAND_STATE_SIZE - 1; index < GLIBC_RAND_STATE_SIZE + 2; ++index)
+        {
+            m_ring[index & 31] = m_ring[(index + 1) & 31];
+        }
+        m_index = GLIBC_RAND_STATE_SIZE + 2;
+
+        /* srandom_r() throws away the first 310 outputs */
+        for (uint32_t index = 0; index < GLIBC_RAND_DISCARD; ++index)
+        {
+            random();
+        }
+    }
+
+    inline uint32_t random(void)
+    {
+        uint32_t value = m_ring[(m_index + 1) & 31] + m_ring[(m_index + 29) & 31];
+        m_ring[m_index & 31] = value;
+        ++m_index;
+        return value >> 1;
+    }
+
+    /* Unrolled by 3: r[i], r[i+1] and r[i+2] only reach back to r[i-1] and beyond */
+    inline void fill(uint32_t *out, uint32_t length)
+    {
+        uint32_t index = 0;
+        for (; index + 3 <= length; index += 3)
+        {
+            uint32_t first = m_ring[(m_index + 1) & 31] + m_ring[(m_index + 29) & 31];
+            uint32_t second = m_ring[(m_index + 2) & 31] + m_ring[(m_index + 30) & 31];
+            uint32_t third = m_ring[(m_index + 3) & 31] + m_ring[(m_index + 31) & 31];
+            m_ring[m_index & 31] = first;
+            m_ring[(m_index + 1) & 31] = second;
+            m_ring[(m_index + 2) & 31] = third;
+            out[index] = first >> 1;
+            out[index + 1] = second >> 1;
+            out[index + 2] = third >> 1;
+            m_index += 3;
+        }
+        for (; index < length; ++index)
+        {
+            out[index] = random();
+        }
+    }
+
+private:
+    uint32_t m_ring[32];
+    uint32_t m_index;
+};
+
+/*
+    GlibcRandKernel run for WIDTH seeds side by side. Every lane walks the
+    same ring index, so each step is one pass over a contiguous row that the
+    compiler can turn into vector adds.
+*/
+class GlibcRandLanes
+{
+public:
+    static const unsigned int WIDTH = 16;
+
+    inline void seed(const uint32_t *values)
+    {
+        int32_t word[WIDTH];
+        for (unsigned int lane = 0; lane < WIDTH; ++lane)
+        {
+            word[lane] = (values[lane] == 0) ? 1 : (int32_t) values[lane];
+            m_ring[0][lane] = word[lane];
+        }
+        for (uint32_t index = 1; index < GLIBC_RAND_STATE_SIZE - 1; ++index)
+        {
+            for (unsigned int lane = 0; lane < WIDTH; ++lane)
+            {
+                int32_t hi = word[lane] / 127773;
+                int32_t lo = word[lane] % 127773;
+                word[lane] = 16807 * lo - 2836 * hi;
+                word[lane] += (word[lane] < 0) ? 2147483647 : 0;
+                m_ring[index][lane] = word[lane];
+            }
+        }
+        for (uint32_t index = GLIBC_RAND_STATE_SIZE - 1; index < GLIBC_RAND_STATE_SIZE + 2; ++index)
+        {
+            for (unsigned int lane = 0; lane < WIDTH; ++lane)
+            {
+                m_ring[index & 31][lane] = m_ring[(index + 1) & 31][lane];
+            }
+        }
+        m_index = GLIBC_RAND_STATE_SIZE + 2;
+
+        uint32_t discard[WIDTH];
+        for (uint32_t index = 0; index < GLIBC_RAND_DISCARD; ++index)
+        {
+            random(discard);
+        }
+    }
+
+    inline void random(uint32_t *out)
+    {
+        /* Sum into a local row first, otherwise the compiler can't rule out the
+            rows overlapping and won't vectorize */
+        const uint32_t *first = m_ring[(m_index + 1) & 31];
+        const uint32_t *second = m_ring[(m_index + 29) & 31];
+        uint32_t next[WIDTH];
+        for (unsigned int lane = 0; lane < WIDTH; ++lane)
+        {
+            next[lane] = first[lane] + second[lane];
+        }
+        for (unsigned int lane = 0; lane < WIDTH; ++lane)
+        {
+            m_ring[m_index & 31][lane] = next[lane];
+            out[lane] = next[lane] >> 1;
+        }
+        ++m_index;
+    }
+
+private:
+    uint32_t m_ring[32][WIDTH];
+    uint32_t m_index;
+};
 
 class GlibcRand: public PRNG
 {
@@ -26,33 +171,54 @@ public:
     void seed(uint32_t value);
     uint32_t getSeed(void);
     uint32_t random(void);
+    void fill(uint32_t *, uint32_t);
 
 private:
     uint32_t seedValue;
+    GlibcRandKernel m_kernel;
+
     uint32_t getStateSize(void);
-    void setState(std::vector<uint32_t> inState);
-    std::vector<uint32_t> getState(void);
+    void setState(OutputSpan);
+    OutputSpan getState(void);
 
-    void setEvidence(std::vector<uint32_t>);
+    void setEvidence(OutputSpan);
 
-    std::vector<uint32_t> predictForward(uint32_t);
-    std::vector<uint32_t> predictBackward(uint32_t);
+    uint32_t predictForward(uint32_t *, uint32_t);
+    uint32_t predictBackward(uint32_t *, uint32_t);
 
     bool setLSB(uint32_t index, uint32_t value);
     void setLSBxor(uint32_t index1, uint32_t index2);
     void setLSBor(uint32_t index1, uint32_t index2);
-    bool handleRemainder(uint32_t index, std::vector<uint32_t>);
+    bool handleRemainder(uint32_t index, const std::vector<uint32_t>&);
 
-    void tune(std::vector<uint32_t>, std::vector<uint32_t>);
+    void tune(OutputSpan, OutputSpan);
     void tune_repeatedIncrements();
     void tune_chainChecking();
 
     bool isInitState(std::deque<uint32_t> *);
 
     bool reverseToSeed(uint32_t *, uint32_t);
+    Fingerprint fingerprint(OutputSpan);
+    void beginSlide(OutputSpan);
+    bool slide(uint32_t);
+
+    uint32_t getSnapshotSize(void);
+    void saveSnapshot(uint32_t *);
+    void restoreSnapshot(const uint32_t *);
+    PRNG* clone(void);
 
     /* Keeps track of what LSBs are known */
     std::vector<LSBState> m_LSBMap;
+
+    /* Scratch for predictions while tuning, sized once and reused */
+    std::vector<uint32_t> m_guesses;
+
+    /* Last 32 outputs of the sliding window, and how many have been seen */
+    uint32_t m_window[GLIBC_RAND_STATE_SIZE];
+    uint32_t m_windowIndex;
+
+    /* Roll back point for hypotheses tried while tuning */
+    uint32_t m_snapshot[GLIBC_RAND_SNAPSHOT_SIZE];
 };
 
 #endif /* GLIBCRAND_H_ */
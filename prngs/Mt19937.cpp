@@ -7,9 +7,15 @@
 
 #include "Mt19937.h"
 
+#include <deque>
+
+/* Inverse of the init_genrand() multiplier, mod 2^32 */
+static const uint32_t INIT_MULTIPLIER_INVERSE = 0x9638806d;
+
 Mt19937::Mt19937()
 {
-    seedValue = generator.default_seed;
+    seedValue = std::mt19937::default_seed;
+    m_kernel.seed(seedValue);
 }
 
 Mt19937::~Mt19937() {}
@@ -22,7 +28,7 @@ const std::string Mt19937::getName()
 void Mt19937::seed(uint32_t value)
 {
     seedValue = value;
-    this->generator.seed(value);
+    m_kernel.seed(value);
 }
 
 uint32_t Mt19937::getSeed()
@@ -32,7 +38,12 @@ uint32_t Mt19937::getSeed()
 
 uint32_t Mt19937::random(void)
 {
-    return this->generator();
+    return m_kernel.random();
+}
+
+void Mt19937::fill(uint32_t *out, uint32_t length)
+{
+    m_kernel.fill(out, length);
 }
 
 uint32_t Mt19937::getStateSize(void)
@@ -40,45 +51,209 @@ uint32_t Mt19937::getStateSize(void)
     return MT19937_STATE_SIZE;
 }
 
-void Mt19937::setState(std::vector<uint32_t> inState)
+/* Takes 624 observed outputs, and keeps the raw state words they were tempered from */
+void Mt19937::setState(OutputSpan inState)
 {
-    m_state = inState;
+    m_state.assign(inState.begin(), inState.end());
     m_state.resize(MT19937_STATE_SIZE, 0);
+    for (uint32_t index = 0; index < m_state.size(); ++index)
+    {
+        m_state[index] = untemper(m_state[index]);
+    }
 }
 
-std::vector<uint32_t> Mt19937::getState(void)
+OutputSpan Mt19937::getState(void)
 {
-    return m_state;
+    return OutputSpan(m_state);
 }
 
-std::vector<uint32_t> Mt19937::predictForward(uint32_t)
+/* The outputs after the state, twisting a copy of it one word at a time */
+uint32_t Mt19937::predictForward(uint32_t *out, uint32_t length)
 {
-    std::vector<uint32_t> ret;
-    //TODO
-    return ret;
+    if (m_state.size() != MT19937_STATE_SIZE)
+    {
+        return 0;
+    }
+    uint32_t ring[MT19937_STATE_SIZE];
+    std::copy(m_state.begin(), m_state.end(), ring);
+
+    for (uint32_t index = 0; index < length; ++index)
+    {
+        uint32_t position = index % MT19937_STATE_SIZE;
+        uint32_t second = ring[(position + 1) % MT19937_STATE_SIZE];
+        uint32_t middle = ring[(position + 397) % MT19937_STATE_SIZE];
+        uint32_t mixed = (ring[position] & 0x80000000) | (second & 0x7fffffff);
+        ring[position] = middle ^ (mixed >> 1) ^ ((second & 1) ? 0x9908b0df : 0);
+        out[index] = Mt19937Kernel::temper(ring[position]);
+    }
+    return length;
 }
 
-std::vector<uint32_t> Mt19937::predictBackward(uint32_t)
+
+/* x[i+624] ^ x[i+397] back to the word twist() mixed: x[i]'s top bit and x[i+1]'s low 31 bits */
+static uint32_t Untwist(uint32_t twisted)
 {
-    std::vector<uint32_t> ret;
-    //TODO
-    return ret;
+    /* The magic constant is the only thing that can set the top bit */
+    if (twisted & 0x80000000)
+    {
+        return ((twisted ^ 0x9908b0df) << 1) | 1;
+    }
+    return twisted << 1;
 }
 
+/*
+    The outputs before the state, oldest first, untwisting a copy of it one
+    word at a time as reverseToSeed() does. Past the seeding the words are
+    made up, but then no outputs came from them either.
+*/
+uint32_t Mt19937::predictBackward(uint32_t *out, uint32_t length)
+{
+    if (m_state.size() != MT19937_STATE_SIZE)
+    {
+        return 0;
+    }
+    uint32_t ring[MT19937_STATE_SIZE];
+    std::copy(m_state.begin(), m_state.end(), ring);
 
+    /* The window starts at ring[front] and wraps around */
+    uint32_t front = 0;
+    for (uint32_t index = 0; index < length; ++index)
+    {
+        uint32_t upper = Untwist(ring[(front + MT19937_STATE_SIZE - 1) % MT19937_STATE_SIZE] ^ ring[(front + 396) % MT19937_STATE_SIZE]);
+        uint32_t lower = Untwist(ring[(front + MT19937_STATE_SIZE - 2) % MT19937_STATE_SIZE] ^ ring[(front + 395) % MT19937_STATE_SIZE]);
+        front = (front + MT19937_STATE_SIZE - 1) % MT19937_STATE_SIZE;
+        ring[front] = (upper & 0x80000000) | (lower & 0x7fffffff);
+        out[length - 1 - index] = Mt19937Kernel::temper(ring[front]);
+    }
+    return length;
+}
+
+/*
+    Walks the state back a word at a time until it looks like it came straight
+    out of seed(). Each twisted word x[i+624] = x[i+397] ^ twist(x[i], x[i+1])
+    gives away the top bit of x[i] and the low 31 bits of x[i+1], so the word
+    before the window comes from the two relations it is part of. x[0] (the
+    seed) is never used whole, so the walk stops at x[1] and inverts that.
+*/
 bool Mt19937::reverseToSeed(uint32_t *outSeed, uint32_t depth)
 {
-    //TODO
+    if (m_state.size() != MT19937_STATE_SIZE)
+    {
+        return false;
+    }
+    std::deque<uint32_t> words(m_state.begin(), m_state.end());
+    for (uint32_t step = 0; step <= depth; ++step)
+    {
+        /* Is words[0] the x[1] of some seed? */
+        uint32_t next = 1812433253U * (words[0] ^ (words[0] >> 30)) + 2;
+        if (words[1] == next && words[2] == 1812433253U * (next ^ (next >> 30)) + 3)
+        {
+            uint32_t mixed = (words[0] - 1) * INIT_MULTIPLIER_INVERSE;
+            *outSeed = mixed ^ (mixed >> 30);
+            return true;
+        }
+
+        uint32_t upper = Untwist(words[MT19937_STATE_SIZE - 1] ^ words[396]);
+        uint32_t lower = Untwist(words[MT19937_STATE_SIZE - 2] ^ words[395]);
+        words.pop_back();
+        words.push_front((upper & 0x80000000) | (lower & 0x7fffffff));
+    }
     return false;
 }
 
-void Mt19937::tune(std::vector<uint32_t> evidenceForward, std::vector<uint32_t> evidenceBackward)
+void Mt19937::tune(OutputSpan evidenceForward, OutputSpan evidenceBackward)
 {
     //TODO
 }
 
-void Mt19937::setEvidence(std::vector<uint32_t>)
+void Mt19937::setEvidence(OutputSpan)
 {
 
 }
 
+
+/* Inverts the output tempering, giving back the raw state word */
+uint32_t Mt19937::untemper(uint32_t value)
+{
+    value ^= value >> 18;
+    value ^= (value << 15) & 0xefc60000;
+
+    uint32_t tmp = value;
+    for (unsigned int round = 0; round < 4; ++round)
+    {
+        tmp = value ^ ((tmp << 7) & 0x9d2c5680);
+    }
+    value = tmp;
+
+    tmp = value ^ (value >> 11);
+    return value ^ (tmp >> 11);
+}
+
+/* Untempered outputs are the raw state, and every state word after the first 624
+    is fixed by x[i] = x[i-227] ^ twist(x[i-624], x[i-623]) */
+Fingerprint Mt19937::fingerprint(OutputSpan observed)
+{
+    Fingerprint result = {0, 0};
+    if (observed.size() <= MT19937_STATE_SIZE)
+    {
+        return result;
+    }
+
+    beginSlide(observed.subspan(0, MT19937_STATE_SIZE));
+    for (uint32_t index = MT19937_STATE_SIZE; index < observed.size(); ++index)
+    {
+        result.tested++;
+        if (slide(observed[index]))
+        {
+            result.satisfied++;
+        }
+    }
+    return result;
+}
+
+void Mt19937::beginSlide(OutputSpan window)
+{
+    for (uint32_t index = 0; index < MT19937_STATE_SIZE; ++index)
+    {
+        m_window[index] = untemper(window[index]);
+    }
+    m_windowPosition = 0;
+}
+
+/* Only the last 624 raw words are ever needed, so the window is a ring */
+bool Mt19937::slide(uint32_t next)
+{
+    uint32_t oldest = m_window[m_windowPosition];
+    uint32_t second = m_window[(m_windowPosition + 1) % MT19937_STATE_SIZE];
+    uint32_t middle = m_window[(m_windowPosition + 397) % MT19937_STATE_SIZE];
+    uint32_t mixed = (oldest & 0x80000000) | (second & 0x7fffffff);
+    uint32_t expected = middle ^ (mixed >> 1) ^ ((second & 1) ? 0x9908b0df : 0);
+
+    uint32_t value = untemper(next);
+    m_window[m_windowPosition] = value;
+    m_windowPosition = (m_windowPosition + 1) % MT19937_STATE_SIZE;
+    return value == expected;
+}
+
+uint32_t Mt19937::getSnapshotSize(void)
+{
+    return MT19937_STATE_SIZE;
+}
+
+/* A state that hasn't been set yet is saved as zeros, so a restore never reads past what was written */
+void Mt19937::saveSnapshot(uint32_t *out)
+{
+    uint32_t count = std::min((uint32_t) m_state.size(), MT19937_STATE_SIZE);
+    std::copy(m_state.begin(), m_state.begin() + count, out);
+    std::fill(out + count, out + MT19937_STATE_SIZE, 0);
+}
+
+void Mt19937::restoreSnapshot(const uint32_t *in)
+{
+    m_state.assign(in, in + MT19937_STATE_SIZE);
+}
+
+PRNG* Mt19937::clone(void)
+{
+    return new Mt19937(*this);
+}
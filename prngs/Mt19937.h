@@ -9,11 +9,145 @@
 #define MT19937_H_
 
 #include <random>
+#include <algorithm>
 #include "PRNG.h"
 
 static const std::string MT19937 = "mt19937";
 static const uint32_t MT19937_STATE_SIZE = 624;
 
+/*
+    Inline, non-virtual MT19937 (bit for bit std::mt19937) for the brute force
+    hot loop. The whole 624 word state is twisted in one go, so fill() can
+    temper a block of outputs at a time.
+*/
+class Mt19937Kernel
+{
+public:
+    inline void seed(uint32_t value)
+    {
+        m_state[0] = value;
+        for (uint32_t index = 1; index < MT19937_STATE_SIZE; ++index)
+        {
+            m_state[index] = 1812433253U * (m_state[index - 1] ^ (m_state[index - 1] >> 30)) + index;
+        }
+        m_index = MT19937_STATE_SIZE;
+    }
+
+    inline uint32_t random(void)
+    {
+        if (m_index == MT19937_STATE_SIZE)
+        {
+            twist();
+        }
+        return temper(m_state[m_index++]);
+    }
+
+    inline void fill(uint32_t *out, uint32_t length)
+    {
+        while (0 < length)
+        {
+            if (m_index == MT19937_STATE_SIZE)
+            {
+                twist();
+            }
+            uint32_t count = std::min(length, MT19937_STATE_SIZE - m_index);
+            for (uint32_t index = 0; index < count; ++index)
+            {
+                out[index] = temper(m_state[m_index + index]);
+            }
+            m_index += count;
+            out += count;
+            length -= count;
+        }
+    }
+
+    static inline uint32_t temper(uint32_t y)
+    {
+        y ^= (y >> 11);
+        y ^= (y << 7) & 0x9d2c5680;
+        y ^= (y << 15) & 0xefc60000;
+        return y ^ (y >> 18);
+    }
+
+private:
+    inline uint32_t mix(uint32_t upper, uint32_t lower)
+    {
+        uint32_t mixed = (upper & 0x80000000) | (lower & 0x7fffffff);
+        return (mixed >> 1) ^ ((lower & 1) ? 0x9908b0df : 0);
+    }
+
+    inline void twist(void)
+    {
+        uint32_t index = 0;
+        for (; index < MT19937_STATE_SIZE - 397; ++index)
+        {
+            m_state[index] = m_state[index + 397] ^ mix(m_state[index], m_state[index + 1]);
+        }
+        for (; index < MT19937_STATE_SIZE - 1; ++index)
+        {
+            m_state[index] = m_state[index - 227] ^ mix(m_state[index], m_state[index + 1]);
+        }
+        m_state[index] = m_state[index - 227] ^ mix(m_state[index], m_state[0]);
+        m_index = 0;
+    }
+
+    uint32_t m_state[MT19937_STATE_SIZE];
+    uint32_t m_index;
+};
+
+/*
+    MT19937 run for WIDTH seeds side by side, with the twist done lazily: each
+    output computes just the one state word it needs,
+        x[i] = x[i-227] ^ twist(x[i-624], x[i-623])
+    in a 624 word ring, instead of regenerating all 624 words up front. A
+    shallow search never pays for state words it doesn't look at.
+*/
+class Mt19937Lanes
+{
+public:
+    static const unsigned int WIDTH = 16;
+
+    inline void seed(const uint32_t *values)
+    {
+        for (unsigned int lane = 0; lane < WIDTH; ++lane)
+        {
+            m_state[0][lane] = values[lane];
+        }
+        for (uint32_t index = 1; index < MT19937_STATE_SIZE; ++index)
+        {
+            for (unsigned int lane = 0; lane < WIDTH; ++lane)
+            {
+                uint32_t previous = m_state[index - 1][lane];
+                m_state[index][lane] = 1812433253U * (previous ^ (previous >> 30)) + index;
+            }
+        }
+        m_position = 0;
+    }
+
+    inline void random(uint32_t *out)
+    {
+        uint32_t *current = m_state[m_position];
+        const uint32_t *next = m_state[(m_position + 1 == MT19937_STATE_SIZE) ? 0 : m_position + 1];
+        const uint32_t *middle = m_state[(m_position < MT19937_STATE_SIZE - 397) ? m_position + 397 : m_position - 227];
+        for (unsigned int lane = 0; lane < WIDTH; ++lane)
+        {
+            uint32_t mixed = (current[lane] & 0x80000000) | (next[lane] & 0x7fffffff);
+            uint32_t y = middle[lane] ^ (mixed >> 1) ^ ((next[lane] & 1) ? 0x9908b0df : 0);
+            current[lane] = y;
+
+            y ^= (y >> 11);
+            y ^= (y << 7) & 0x9d2c5680;
+            y ^= (y << 15) & 0xefc60000;
+            out[lane] = y ^ (y >> 18);
+        }
+        m_position = (m_position + 1 == MT19937_STATE_SIZE) ? 0 : m_position + 1;
+    }
+
+private:
+    uint32_t m_state[MT19937_STATE_SIZE][WIDTH];
+    uint32_t m_position;
+};
+
 class Mt19937: public PRNG
 {
 public:
@@ -24,22 +158,37 @@ public:
     void seed(uint32_t value);
     uint32_t getSeed(void);
     uint32_t random(void);
+    void fill(uint32_t *, uint32_t);
 
     uint32_t getStateSize(void);
-    void setState(std::vector<uint32_t>);
-    std::vector<uint32_t> getState(void);
+    void setState(OutputSpan);
+    OutputSpan getState(void);
 
-    void setEvidence(std::vector<uint32_t>);
+    void setEvidence(OutputSpan);
 
-    std::vector<uint32_t> predictForward(uint32_t);
-    std::vector<uint32_t> predictBackward(uint32_t);
-    void tune(std::vector<uint32_t>, std::vector<uint32_t>);
+    uint32_t predictForward(uint32_t *, uint32_t);
+    uint32_t predictBackward(uint32_t *, uint32_t);
+    void tune(OutputSpan, OutputSpan);
 
     bool reverseToSeed(uint32_t *, uint32_t);
+    Fingerprint fingerprint(OutputSpan);
+    void beginSlide(OutputSpan);
+    bool slide(uint32_t);
+
+    uint32_t getSnapshotSize(void);
+    void saveSnapshot(uint32_t *);
+    void restoreSnapshot(const uint32_t *);
+    PRNG* clone(void);
 
 private:
+    uint32_t untemper(uint32_t);
+
     uint32_t seedValue;
-    std::mt19937 generator;
+    Mt19937Kernel m_kernel;
+
+    /* Untempered outputs of the sliding window, oldest at m_windowPosition */
+    uint32_t m_window[MT19937_STATE_SIZE];
+    uint32_t m_windowPosition;
 };
 
 #endif /* MT19937_H_ */
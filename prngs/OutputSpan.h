@@ -0,0 +1,41 @@
+/*
+ * OutputSpan.h
+ *
+ *      Non-owning view over a run of 32-bit outputs. Used to hand windows
+ *      of the observed values to the PRNGs without copying them; whoever
+ *      owns the buffer must keep it alive as long as the view is in use.
+ */
+
+#ifndef OUTPUTSPAN_H_
+#define OUTPUTSPAN_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+class OutputSpan
+{
+public:
+    OutputSpan() : m_data(NULL), m_size(0) {}
+    OutputSpan(const uint32_t *data, uint32_t size) : m_data(data), m_size(size) {}
+    OutputSpan(const std::vector<uint32_t>& values)
+        : m_data(values.empty() ? NULL : &values[0]), m_size(values.size()) {}
+
+    inline const uint32_t& operator[](uint32_t index) const { return m_data[index]; }
+    inline const uint32_t* begin(void) const { return m_data; }
+    inline const uint32_t* end(void) const { return m_data + m_size; }
+    inline uint32_t size(void) const { return m_size; }
+    inline bool empty(void) const { return m_size == 0; }
+
+    /* View of count values starting at first */
+    inline OutputSpan subspan(uint32_t first, uint32_t count) const
+    {
+        return OutputSpan(m_data + first, count);
+    }
+
+private:
+    const uint32_t *m_data;
+    uint32_t m_size;
+};
+
+#endif /* OUTPUTSPAN_H_ */
@@ -12,6 +12,14 @@
 #define PRNG_H_
 
 #include <vector>
+#include "OutputSpan.h"
+
+/* Tally of an engine's defining relations checked against observed outputs */
+struct Fingerprint
+{
+    uint32_t tested;     // Relations we had enough outputs to check
+    uint32_t satisfied;  // Relations that held
+};
 
 class PRNG
 {
@@ -21,20 +29,41 @@ public:
     virtual void seed(uint32_t) = 0;
     virtual uint32_t getSeed(void) = 0;
     virtual uint32_t random(void) = 0;
+    virtual void fill(uint32_t *, uint32_t) = 0;
     virtual uint32_t getStateSize(void) = 0;
-    virtual void setState(std::vector<uint32_t>) = 0;
-    virtual std::vector<uint32_t> getState(void) = 0;
-    virtual void setEvidence(std::vector<uint32_t>) = 0;
-    virtual std::vector<uint32_t> predictForward(uint32_t) = 0;
-    virtual std::vector<uint32_t> predictBackward(uint32_t) = 0;
-    virtual void tune(std::vector<uint32_t>, std::vector<uint32_t>) = 0;
+    virtual void setState(OutputSpan) = 0;
+    virtual OutputSpan getState(void) = 0;
+    virtual void setEvidence(OutputSpan) = 0;
+    /* Write up to length predictions into the caller's buffer, returns how many were written.
+        Forward starts just after the state; backward ends just before it, so the output
+        right before the state is the last one written. 0 means no state has been set */
+    virtual uint32_t predictForward(uint32_t *, uint32_t) = 0;
+    virtual uint32_t predictBackward(uint32_t *, uint32_t) = 0;
+    virtual void tune(OutputSpan, OutputSpan) = 0;
     virtual bool reverseToSeed(uint32_t *, uint32_t) = 0;
+    virtual Fingerprint fingerprint(OutputSpan) = 0;
+
+    /* Sliding window inference: prime the window with getStateSize() outputs,
+        then feed it each following output in turn. slide() returns true if the
+        window predicted that output, and moves the window along by one. */
+    virtual void beginSlide(OutputSpan) = 0;
+    virtual bool slide(uint32_t) = 0;
+
+    /* Fixed-size copy of the state being inferred, for trying a hypothesis and
+        rolling it back. Save/restore go through caller-owned storage of
+        getSnapshotSize() words, so branching never touches the heap. A
+        snapshot always covers the state words; bookkeeping an engine keeps
+        on the side is only covered where that engine says so. */
+    virtual uint32_t getSnapshotSize(void) = 0;
+    virtual void saveSnapshot(uint32_t *) = 0;
+    virtual void restoreSnapshot(const uint32_t *) = 0;
+    virtual PRNG* clone(void) = 0;
 
     virtual ~PRNG(){};
 
 protected:
     std::vector<uint32_t> m_state;
-    std::vector<uint32_t> m_evidence;
+    OutputSpan m_evidence;  // Not owned, the caller keeps it alive
 
 };
 
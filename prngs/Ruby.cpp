@@ -7,11 +7,15 @@
 
 #include "Ruby.h"
 
+#include <deque>
+
+/* Inverse of the init_genrand() multiplier, mod 2^32 */
+static const uint32_t INIT_MULTIPLIER_INVERSE = 0x9638806d;
+
 Ruby::Ruby()
 {
     seedValue = 0;
-    mt = new MT;
-    init_genrand(mt, seedValue);
+    m_kernel.seed(seedValue);
 }
 
 Ruby::~Ruby() {}
@@ -23,9 +27,8 @@ const std::string Ruby::getName()
 
 void Ruby::seed(uint32_t value)
 {
-    mt = new MT;
     seedValue = value;
-    init_genrand(mt, value);
+    m_kernel.seed(value);
 }
 
 uint32_t Ruby::getSeed()
@@ -35,102 +38,199 @@ uint32_t Ruby::getSeed()
 
 uint32_t Ruby::random()
 {
-    return genrand_int32(mt);
+    return m_kernel.random();
 }
 
 
-void Ruby::init_genrand(struct MT* mt, unsigned int s)
+void Ruby::fill(uint32_t *out, uint32_t length)
 {
-    int j;
-    mt->state[0] = s & 0xffffffffU;
-    for (j=1; j<N; j++) {
-        mt->state[j] = (1812433253U * (mt->state[j-1] ^ (mt->state[j-1] >> 30)) + j);
-        /* See Knuth TAOCP Vol2. 3rd Ed. P.106 for multiplier. */
-        /* In the previous versions, MSBs of the seed affect   */
-        /* only MSBs of the array state[].                     */
-        /* 2002/01/09 modified by Makoto Matsumoto             */
-        mt->state[j] &= 0xffffffff;  /* for >32 bit machines */
-    }
-    mt->left = 1;
-    mt->next = mt->state + N;
+    m_kernel.fill(out, length);
 }
 
-void Ruby::next_state(struct MT *mt)
+uint32_t Ruby::getStateSize(void)
 {
-    unsigned int *p = mt->state;
-    int j;
-
-    mt->left = N;
-    mt->next = mt->state;
-
-    for (j=N-M+1; --j; p++)
-        *p = p[M] ^ TWIST(p[0], p[1]);
+    return RUBY_STATE_SIZE;
+}
 
-    for (j=M; --j; p++)
-        *p = p[M-N] ^ TWIST(p[0], p[1]);
+/* Takes N observed outputs, and keeps the raw state words they were tempered from */
+void Ruby::setState(OutputSpan inState)
+{
+    m_state.assign(inState.begin(), inState.end());
+    m_state.resize(RUBY_STATE_SIZE, 0);
+    for (uint32_t j = 0; j < N; ++j)
+    {
+        m_state[j] = untemper(m_state[j]);
+    }
+}
 
-    *p = p[M-N] ^ TWIST(p[0], mt->state[0]);
+OutputSpan Ruby::getState(void)
+{
+    return OutputSpan(m_state);
 }
 
-uint32_t Ruby::genrand_int32(struct MT *mt)
+/* The outputs after the state, the same recurrence as slide() on a copy of it */
+uint32_t Ruby::predictForward(uint32_t *out, uint32_t length)
 {
-    /* mt must be initialized */
-    unsigned int y;
+    if (m_state.size() != N)
+    {
+        return 0;
+    }
+    uint32_t p[N];
+    std::copy(m_state.begin(), m_state.end(), p);
+
+    for (uint32_t j = 0; j < length; ++j)
+    {
+        uint32_t i = j % N;
+        p[i] = p[(i+M) % N] ^ TWIST(p[i], p[(i+1) % N]);
+        out[j] = RubyKernel::temper(p[i]);
+    }
+    return length;
+}
 
-    if (--mt->left <= 0) next_state(mt);
-    y = *mt->next++;
+/* x[i+N] ^ x[i+M] back to MIXBITS(x[i], x[i+1]), only the top bit and low 31 bits of which mean anything */
+static uint32_t Untwist(uint32_t twisted)
+{
+    if (twisted & UMASK)
+    {
+        return ((twisted ^ MATRIX_A) << 1) | 1U;  // Only MATRIX_A sets the top bit
+    }
+    return twisted << 1;
+}
 
-    /* Tempering */
-    y ^= (y >> 11);
-    y ^= (y << 7) & 0x9d2c5680;
-    y ^= (y << 15) & 0xefc60000;
-    y ^= (y >> 18);
+/* The outputs before the state, oldest first, as in Mt19937::predictBackward() */
+uint32_t Ruby::predictBackward(uint32_t *out, uint32_t length)
+{
+    if (m_state.size() != N)
+    {
+        return 0;
+    }
+    uint32_t p[N];
+    std::copy(m_state.begin(), m_state.end(), p);
+
+    uint32_t front = 0;  // p[front] is the oldest word, the rest follow it around the ring
+    for (uint32_t j = 0; j < length; ++j)
+    {
+        uint32_t upper = Untwist(p[(front+N-1) % N] ^ p[(front+M-1) % N]);
+        uint32_t lower = Untwist(p[(front+N-2) % N] ^ p[(front+M-2) % N]);
+        front = (front+N-1) % N;
+        p[front] = (upper & UMASK) | (lower & LMASK);
+        out[length-1-j] = RubyKernel::temper(p[front]);
+    }
+    return length;
+}
 
-    return y;
+/* Walks the state back to x[1] of init_genrand(), as in Mt19937::reverseToSeed() */
+bool Ruby::reverseToSeed(uint32_t *outSeed, uint32_t depth)
+{
+    if (m_state.size() != N)
+    {
+        return false;
+    }
+    std::deque<uint32_t> p(m_state.begin(), m_state.end());
+    for (uint32_t step = 0; step <= depth; ++step)
+    {
+        uint32_t next = 1812433253U * (p[0] ^ (p[0] >> 30)) + 2;
+        if (p[1] == next && p[2] == 1812433253U * (next ^ (next >> 30)) + 3)
+        {
+            uint32_t mixed = (p[0] - 1) * INIT_MULTIPLIER_INVERSE;
+            *outSeed = mixed ^ (mixed >> 30);
+            return true;
+        }
+
+        uint32_t upper = Untwist(p[N-1] ^ p[M-1]);
+        uint32_t lower = Untwist(p[N-2] ^ p[M-2]);
+        p.pop_back();
+        p.push_front((upper & UMASK) | (lower & LMASK));
+    }
+    return false;
 }
 
-uint32_t Ruby::getStateSize(void)
+void Ruby::tune(OutputSpan evidenceForward, OutputSpan evidenceBackward)
 {
-    return RUBY_STATE_SIZE;
+    //TODO
 }
 
-void Ruby::setState(std::vector<uint32_t> inState)
+void Ruby::setEvidence(OutputSpan)
 {
-    m_state = inState;
-    m_state.resize(RUBY_STATE_SIZE, 0);
+
 }
 
-std::vector<uint32_t> Ruby::getState(void)
+uint32_t Ruby::untemper(uint32_t y)
 {
-    return m_state;
+    uint32_t tmp;
+
+    y ^= (y >> 18);
+    y ^= (y << 15) & 0xefc60000;
+
+    tmp = y;
+    for (int j=0; j<4; j++)
+        tmp = y ^ ((tmp << 7) & 0x9d2c5680);
+    y = tmp;
+
+    tmp = y ^ (y >> 11);
+    return y ^ (tmp >> 11);
 }
 
-std::vector<uint32_t> Ruby::predictForward(uint32_t)
+/* Same recurrence as next_state(), checked on the untempered outputs */
+Fingerprint Ruby::fingerprint(OutputSpan observed)
 {
-    std::vector<uint32_t> ret;
-    //TODO
-    return ret;
+    Fingerprint result = {0, 0};
+    if (observed.size() <= RUBY_STATE_SIZE)
+    {
+        return result;
+    }
+
+    beginSlide(observed.subspan(0, RUBY_STATE_SIZE));
+    for (uint32_t index = RUBY_STATE_SIZE; index < observed.size(); ++index)
+    {
+        result.tested++;
+        if (slide(observed[index]))
+        {
+            result.satisfied++;
+        }
+    }
+    return result;
 }
 
-std::vector<uint32_t> Ruby::predictBackward(uint32_t)
+void Ruby::beginSlide(OutputSpan window)
 {
-    std::vector<uint32_t> ret;
-    //TODO
-    return ret;
+    for (uint32_t j = 0; j < N; ++j)
+    {
+        m_window[j] = untemper(window[j]);
+    }
+    m_windowPosition = 0;
 }
 
-bool Ruby::reverseToSeed(uint32_t *outSeed, uint32_t depth)
+bool Ruby::slide(uint32_t next)
 {
-    return false;
+    uint32_t *p = m_window;
+    uint32_t i = m_windowPosition;
+    uint32_t expected = p[(i+M) % N] ^ TWIST(p[i], p[(i+1) % N]);
+
+    p[i] = untemper(next);
+    m_windowPosition = (i+1) % N;
+    return p[i] == expected;
 }
 
-void Ruby::tune(std::vector<uint32_t> evidenceForward, std::vector<uint32_t> evidenceBackward)
+uint32_t Ruby::getSnapshotSize(void)
 {
-    //TODO
+    return RUBY_STATE_SIZE;
 }
 
-void Ruby::setEvidence(std::vector<uint32_t>)
+/* A state that hasn't been set yet is saved as zeros, so a restore never reads past what was written */
+void Ruby::saveSnapshot(uint32_t *out)
 {
+    uint32_t count = std::min((uint32_t) m_state.size(), RUBY_STATE_SIZE);
+    std::copy(m_state.begin(), m_state.begin() + count, out);
+    std::fill(out + count, out + RUBY_STATE_SIZE, 0);
+}
 
+void Ruby::restoreSnapshot(const uint32_t *in)
+{
+    m_state.assign(in, in + RUBY_STATE_SIZE);
 }
 
+PRNG* Ruby::clone(void)
+{
+    return new Ruby(*this);
+}
@@ -9,6 +9,7 @@
 #define RUBY_H_
 
 #include <string>
+#include <algorithm>
 #include "PRNG.h"
 
 static const std::string RUBY_RAND = "ruby-rand";
@@ -32,6 +33,101 @@ struct MT {
     int left;
 };
 
+/* Ruby's MT, inline and non-virtual for the brute force hot loop */
+class RubyKernel
+{
+public:
+    inline void seed(uint32_t value)
+    {
+        init_genrand(&mt, value);
+    }
+
+    inline uint32_t random(void)
+    {
+        return genrand_int32(&mt);
+    }
+
+    /* Tempers straight out of each freshly twisted block, same outputs as genrand_int32() */
+    inline void fill(uint32_t *out, uint32_t length)
+    {
+        while (0 < length)
+        {
+            if (mt.left <= 1)
+            {
+                next_state(&mt);
+                mt.left = N + 1;  /* genrand_int32() takes its first word without counting it */
+            }
+            uint32_t count = std::min(length, (uint32_t) mt.left - 1);
+            for (uint32_t j = 0; j < count; ++j)
+            {
+                out[j] = temper(mt.next[j]);
+            }
+            mt.next += count;
+            mt.left -= count;
+            out += count;
+            length -= count;
+        }
+    }
+
+    static inline uint32_t temper(unsigned int y)
+    {
+        /* Tempering */
+        y ^= (y >> 11);
+        y ^= (y << 7) & 0x9d2c5680;
+        y ^= (y << 15) & 0xefc60000;
+        y ^= (y >> 18);
+
+        return y;
+    }
+
+private:
+    inline void init_genrand(struct MT *mt, unsigned int s)
+    {
+        int j;
+        mt->state[0] = s & 0xffffffffU;
+        for (j=1; j<N; j++) {
+            mt->state[j] = (1812433253U * (mt->state[j-1] ^ (mt->state[j-1] >> 30)) + j);
+            /* See Knuth TAOCP Vol2. 3rd Ed. P.106 for multiplier. */
+            /* In the previous versions, MSBs of the seed affect   */
+            /* only MSBs of the array state[].                     */
+            /* 2002/01/09 modified by Makoto Matsumoto             */
+            mt->state[j] &= 0xffffffff;  /* for >32 bit machines */
+        }
+        mt->left = 1;
+        mt->next = mt->state + N;
+    }
+
+    inline void next_state(struct MT *mt)
+    {
+        unsigned int *p = mt->state;
+        int j;
+
+        mt->left = N;
+        mt->next = mt->state;
+
+        for (j=N-M+1; --j; p++)
+            *p = p[M] ^ TWIST(p[0], p[1]);
+
+        for (j=M; --j; p++)
+            *p = p[M-N] ^ TWIST(p[0], p[1]);
+
+        *p = p[M-N] ^ TWIST(p[0], mt->state[0]);
+    }
+
+    inline uint32_t genrand_int32(struct MT *mt)
+    {
+        /* mt must be initialized */
+        unsigned int y;
+
+        if (--mt->left <= 0) next_state(mt);
+        y = *mt->next++;
+
+        return temper(y);
+    }
+
+    MT mt;
+};
+
 
 class Ruby: public PRNG
 {
@@ -43,26 +139,37 @@ public:
     void seed(uint32_t value);
     uint32_t getSeed(void);
     uint32_t random(void);
+    void fill(uint32_t *, uint32_t);
 
     uint32_t getStateSize(void);
-    void setState(std::vector<uint32_t>);
-    std::vector<uint32_t> getState(void);
+    void setState(OutputSpan);
+    OutputSpan getState(void);
 
-    void setEvidence(std::vector<uint32_t>);
+    void setEvidence(OutputSpan);
 
-    std::vector<uint32_t> predictForward(uint32_t);
-    std::vector<uint32_t> predictBackward(uint32_t);
-    void tune(std::vector<uint32_t>, std::vector<uint32_t>);
+    uint32_t predictForward(uint32_t *, uint32_t);
+    uint32_t predictBackward(uint32_t *, uint32_t);
+    void tune(OutputSpan, OutputSpan);
 
     bool reverseToSeed(uint32_t *, uint32_t);
+    Fingerprint fingerprint(OutputSpan);
+    void beginSlide(OutputSpan);
+    bool slide(uint32_t);
+
+    uint32_t getSnapshotSize(void);
+    void saveSnapshot(uint32_t *);
+    void restoreSnapshot(const uint32_t *);
+    PRNG* clone(void);
 
 private:
-    void init_genrand(struct MT *mt, unsigned int s);
-    void next_state(struct MT *mt);
-    uint32_t genrand_int32(struct MT *mt);
+    uint32_t untemper(uint32_t);
 
-    MT *mt;
+    RubyKernel m_kernel;
     uint32_t seedValue;
+
+    /* Untempered outputs of the sliding window, a ring with the oldest at m_windowPosition */
+    uint32_t m_window[N];
+    uint32_t m_windowPosition;
 };
 
 #endif /* RUBY_H_ */
@@ -20,14 +20,25 @@
 #include <getopt.h>
 #include <limits.h>
 #include <stdint.h>
+#include <math.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <string>
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 
 #include "ConsoleColors.h"
+#include "LockFreeQueue.h"
+#include "Observations.h"
 #include "PRNGFactory.h"
+#include "Results.h"
+#include "Telemetry.h"
+#include "Trace.h"
+#include "Topology.h"
 #include "prngs/PRNG.h"
 
 using std::chrono::seconds;
@@ -35,23 +46,193 @@ using std::chrono::milliseconds;
 using std::chrono::duration_cast;
 using std::chrono::steady_clock;
 
-// Pair of <seed, quality of fit>
-typedef std::pair<uint32_t, double> Seed;
+/* One pass of the brute force over the whole seed range, at a single depth */
+struct SearchTier
+{
+    uint32_t depth;
+    uint64_t chunkSize;
+    uint64_t chunkCount;
+    uint64_t firstChunk;  // Index of the tier's first chunk among all of the job's chunks
+    std::vector<uint64_t> hintChunks;  // Chunks holding the hint seeds, sorted, searched outward from
+};
+
+/* A seed that got through the filter, waiting to be verified */
+struct Candidate
+{
+    unsigned int engine;
+    uint32_t seed;
+    uint32_t depth;
+};
+
+static const size_t CANDIDATE_QUEUE_SIZE = 4096;
+
+/* Seeds a worker collects before writing them to the spill file */
+static const size_t SPILL_BATCH_SIZE = 4096;
+
+/* How often the result stream gets a progress record */
+static const double STREAM_PROGRESS_SECONDS = 1.0;
+
+/* Everything the brute force workers share about one run */
+struct SearchJob
+{
+    SearchJob() : isFound(false), candidates(CANDIDATE_QUEUE_SIZE) {}
+
+    std::vector<std::string> rngs;  // PRNGs to test every seed against, cheapest first
+    std::string variant;            // Kernel variant to use, empty for the fastest the CPU supports
+    uint32_t lowerBoundSeed;
+    uint64_t seedCount;
+    double minimumConfidence;
+    std::vector<SearchTier> tiers;  // Shallowest first, the last one is the full depth
+    std::vector<uint32_t> hints;    // Seeds to search outward from, if any
+    uint64_t chunkCount;            // Over all tiers
+    std::atomic<uint64_t> nextChunk;  // Next chunk to hand out to whichever worker asks first
+    bool hasDeadline;
+    steady_clock::time_point deadline;
+    uint64_t stepBudget;            // Generator steps allowed over all workers, 0 for no limit
+    std::atomic<uint64_t> stepsUsed;
+    std::vector<Seed> bestFits;     // Best fit each worker has seen, whatever the minimum confidence
+    std::atomic<bool> isFound;      // Set once a seed matched every observed value
+    std::vector<TopSeeds> results;  // The most confident seeds each worker verified
+    size_t resultLimit;             // How many of them each worker keeps
+    SeedSpill *spill;               // Every seed that passed, NULL for none
+    std::vector<uint16_t> spillIds; // Each PRNG's place in the -h list, which is what the spill file records
+    ResultStream *stream;           // Every seed that passed as JSON, as soon as it's verified, NULL for none
+    LockFreeQueue<Candidate> candidates;  // Filtered seeds, verified by whichever worker gets to them
+    Telemetry *telemetry;
+    bool isCountingCycles;          // Whether workers open perf counters around the filter
+    std::vector<const char*> traceLabels;  // PRNG names, in the job's order, for trace spans
+    std::atomic<unsigned int> activeWorkers;  // Workers that haven't returned yet
+    const Topology *topology;       // Where to pin each worker, NULL to let them float
+    std::vector<std::vector<uint32_t> > replicas;  // Pinned: the observed values, copied onto each NUMA node
+    std::mutex replicaLock;
+};
+
+/* What one worker keeps between brute force chunks */
+struct SearchWorkspace
+{
+    std::vector<FilterKernel> filters;  // Per PRNG, in the job's order
+    std::vector<SearchKernel> verifiers;
+    std::vector<uint32_t> survivors;
+    const uint32_t *observed;       // The copy of the observed values nearest this worker
+    std::vector<Seed> answers;      // The verifier's output for one candidate
+    std::vector<Seed> shallower;    // Its output for a seed at the tier before, when the seed comes up again
+    TopSeeds top;
+    std::vector<Seed> spilled;      // Waiting to be written to the spill file
+    Seed best;
+    unsigned int id;                // The worker's telemetry slots
+    PerfCounters *counters;         // NULL unless counting cycles
+};
+
+/* How long a search may run for, and how much work it may do; zero for no limit */
+struct SearchBudget
+{
+    double seconds;
+    uint64_t steps;
+};
+
+/* What to measure about the search beyond the progress line */
+struct TelemetryOptions
+{
+    bool isCountingCycles;
+    std::string metricsPath;  // Where to dump the counters as JSON, empty for nowhere
+};
+
+/* What to keep of the seeds that pass */
+struct ResultOptions
+{
+    size_t limit;           // The most confident seeds kept per worker, and reported
+    std::string spillPath;  // Where to write every seed that passed, empty for nowhere
+    ResultStream *stream;   // Where to stream results to, NULL for nowhere
+};
+
+/* The best window scored so far for one PRNG */
+struct StateGuess
+{
+    StateGuess() : matches(0), window(0) {}
+    uint32_t matches;
+    uint32_t window;
+    std::vector<uint32_t> state;
+};
+
+/* Everything the state inference workers share about one run */
+struct InferenceJob
+{
+    std::vector<std::string> names;         // PRNGs with enough observed values to infer the state of
+    std::vector<const char*> traceLabels;   // The same names, for trace spans
+    std::vector<PRNG*> prototypes;          // One per PRNG with the evidence set, each worker clones them
+    std::vector<uint32_t> unitCounts;       // Windows (or sliding segments) each PRNG has to score
+    std::vector<bool> sliding;              // Per PRNG, whether it uses sliding window rather than classic inference
+    std::vector<std::vector<uint32_t> > runs;  // Sliding mode: which observed values each PRNG predicted
+    std::vector<std::atomic<uint32_t> > segmentsLeft;  // Sliding mode: segments still to slide, per PRNG
+    std::vector<StateGuess> slidingBest;    // Sliding mode: best window per PRNG, once all its segments are in
+    uint32_t segmentSize;
+    uint64_t taskCount;
+    std::atomic<uint64_t> nextTask;
+    std::atomic<uint64_t> tasksDone;        // For the progress line
+    std::atomic<bool> isFound;              // Set by the first worker to verify a state
+    PRNG *solved;                           // That worker's PRNG, in the verified state
+    unsigned int solvedEngine;
+};
+
+
+/* What the planner decided to run, and what it expects that to cost */
+struct SearchPlan
+{
+    std::string strategy;               // "race", "infer" or "brute"
+    std::vector<std::string> inferred;  // PRNGs with enough observed values to infer the state of
+    std::vector<bool> sliding;          // For each of those, sliding window rather than classic inference
+    bool isDeepening;
+    unsigned int threads;
+    bool isPinned;                      // Each worker bound to its own CPU, with node-local observed values
+    double inferenceSeconds;            // Estimates, on all the threads
+    double searchSeconds;
+};
+
+/* What one worker keeps between inference tasks */
+struct InferenceWorkspace
+{
+    std::vector<PRNG*> generators;          // Clones of the job's prototypes
+    std::vector<uint32_t> predictions;
+    std::vector<StateGuess> best;           // Best classic window per PRNG
+};
+
+/* What the fingerprint pass concluded about one PRNG */
+struct EngineFit
+{
+    std::string name;
+    double score;         // Percentage of the PRNG's relations that held
+    bool isTested;        // False when there were too few outputs to check any relation
+    bool isPlausible;     // Enough of its relations held, so the values look like consecutive outputs of it
+    bool canInferState;   // Plausible, with enough outputs to attempt state inference
+};
 
 static std::vector<uint32_t> observedOutputs;
 static const unsigned int ONE_YEAR = 31536000;
+static const uint32_t CALIBRATION_SEEDS = 32;
+static const double CHUNK_SECONDS = 0.05;
+static const uint32_t CALIBRATION_WINDOWS = 4;
+static const double INFERENCE_SECONDS = 10.0;
+static const double DEEPENING_SECONDS = 60.0;
+static const double FINGERPRINT_CONFIDENCE = 90.0;
+static const uint32_t SLIDING_SEGMENT_SIZE = 65536;
+static const uint32_t FIRST_TIER_DEPTH = 256;
+static const uint32_t TIER_GROWTH = 8;
 
 void Usage(PRNGFactory factory, unsigned int threads)
 {
     std::cout << BOLD << "Untwister" << RESET << " - Recover PRNG seeds from observed values." << std::endl;
-    std::cout << "\t-i <input_file> [-d <depth> ] [-r <prng>] [-g <seed>] [-t <threads>] [-c <confidence>]\n" << std::endl;
-    std::cout << "\t-i <input_file>\n\t\tPath to file input file containing observed results of your RNG. The contents" << std::endl;
-    std::cout << "\t\tare expected to be newline separated 32-bit integers. See test_input.txt for" << std::endl;
-    std::cout << "\t\tan example." << std::endl;
+    std::cout << "\t-i <input_file> [-d <depth> ] [-r <prng>[,<prng>...]] [-g <seed>] [-t <threads>] [-c <confidence>]\n" << std::endl;
+    std::cout << "\t-i <input_file>\n\t\tPath to file input file containing observed results of your RNG, - for stdin. The contents" << std::endl;
+    std::cout << "\t\tare expected to be newline separated 32-bit integers, decimal or 0x hex. See" << std::endl;
+    std::cout << "\t\ttest_input.txt for an example." << std::endl;
+    std::cout << "\t-F <format>\n\t\tHow the input file is laid out: text (default, one value per line)," << std::endl;
+    std::cout << "\t\tcsv:<column> (comma separated, values in that column counting from 1, header optional)" << std::endl;
+    std::cout << "\t\tor binary (raw little-endian 32-bit values)" << std::endl;
     std::cout << "\t-d <depth>\n\t\tThe depth (default 1000) to inspect for each seed value when brute forcing." << std::endl;
     std::cout << "\t\tChoosing a higher depth value will make brute forcing take longer (linearly), but is" << std::endl;
     std::cout << "\t\trequired for cases where the generator has been used many times already." << std::endl;
-    std::cout << "\t-r <prng>\n\t\tThe PRNG algorithm to use. Supported PRNG algorithms:" << std::endl;
+    std::cout << "\t-r <prng>[,<prng>...]\n\t\tThe PRNG algorithm(s) to use. Several comma separated PRNGs are" << std::endl;
+    std::cout << "\t\tsearched together in a single pass. Supported PRNG algorithms:" << std::endl;
     std::vector<std::string> names = factory.getNames();
     for (unsigned int index = 0; index < names.size(); ++index)
     {
@@ -62,307 +243,1528 @@ void Usage(PRNGFactory factory, unsigned int threads)
     }
     std::cout << "\t-u\n\t\tUse bruteforce, but only for unix timestamp values within a range of +/- 1 " << std::endl;
     std::cout << "\t\tyear from the current time." << std::endl;
+    std::cout << "\t-a <lower>:<upper>\n\t\tOnly brute force seeds from lower to upper, inclusive" << std::endl;
+    std::cout << "\t-n <seed>[,<seed>...]\n\t\tSearch outward from these seeds (e.g. timestamps from logs) instead of" << std::endl;
+    std::cout << "\t\tfrom the bottom of the range, nearest seeds first" << std::endl;
     std::cout << "\t-g <seed>\n\t\tGenerate a test set of random numbers from the given seed (at a random depth)" << std::endl;
     std::cout << "\t-c <confidence>\n\t\tSet the minimum confidence percentage to report" << std::endl;
-    std::cout << "\t-t <threads>\n\t\tSpawn this many threads (default is " << threads << ")" << std::endl;
+    std::cout << "\t-K <count>\n\t\tReport only this many of the most confident seeds (default 1000), each thread" << std::endl;
+    std::cout << "\t\tkeeps no more than that however many pass -c" << std::endl;
+    std::cout << "\t-o <results_file>\n\t\tStream every seed that passes -c to this file (- for stdout, with everything else" << std::endl;
+    std::cout << "\t\ton stderr) as newline delimited JSON as soon as it's found, with progress every second" << std::endl;
+    std::cout << "\t-S <spill_file>\n\t\tWrite every seed that passes -c to this file, as 8 byte little-endian records of" << std::endl;
+    std::cout << "\t\tseed (uint32), PRNG (uint16, its place among the supported PRNGs under -r from 0) and confidence in 1/100ths of a percent (uint16)" << std::endl;
+    std::cout << "\t-t <threads>\n\t\tSpawn this many threads (default is as many as the planner finds work for, up to " << threads << "," << std::endl;
+    std::cout << "\t\tthe CPUs this process may use capped by its cgroup CPU quota)" << std::endl;
+    std::cout << "\t-w\n\t\tPin each worker to a CPU of its own, distinct cores before hyperthreads and spread over" << std::endl;
+    std::cout << "\t\tthe NUMA nodes, with a copy of the observed values on every node" << std::endl;
+    std::cout << "\t-l <seconds>\n\t\tStop brute forcing and state inference after this many seconds, and report how far the brute force got" << std::endl;
+    std::cout << "\t-b <steps>\n\t\tStop brute forcing after this many generator steps (seeds times depth)" << std::endl;
+    std::cout << "\t-p\n\t\tCount CPU cycles and instructions per worker with perf_event_open, and show IPC" << std::endl;
+    std::cout << "\t-j <metrics_file>\n\t\tWrite the search counters (seeds, outputs, filter rejects, rates, IPC) per" << std::endl;
+    std::cout << "\t\tPRNG and per worker thread to this file as JSON when the run ends" << std::endl;
+    std::cout << "\t-x <trace_file>\n\t\tRecord a timeline of the run (setup, inference windows, tune passes, chunks," << std::endl;
+    std::cout << "\t\tverification) to this file as Chrome trace-event JSON" << std::endl;
+    std::cout << "\t-k <kernel>\n\t\tForce a brute force kernel variant instead of the fastest this CPU supports:" << std::endl;
+    std::vector<std::string> variants = factory.getVariantNames();
+    for (unsigned int index = 0; index < variants.size(); ++index)
+    {
+        std::cout << "\t\t" << BOLD << " * " << RESET << variants[index];
+        if (!PRNGFactory::isVariantSupported(variants[index]))
+            std::cout << " (unsupported)";
+        std::cout << std::endl;
+    }
+    std::cout << "\t-q <percent>\n\t\tShare of a PRNG's fingerprint relations that must hold for it to look like" << std::endl;
+    std::cout << "\t\tconsecutive outputs of that PRNG (default " << FINGERPRINT_CONFIDENCE << ")" << std::endl;
+    std::cout << "\t-f\n\t\tInfer the state of PRNGs the fingerprint rules out too (they are always brute forced)" << std::endl;
+    std::cout << "\t-m <strategy>\n\t\tWhat to run: auto (default, let the planner choose), race (state inference" << std::endl;
+    std::cout << "\t\tagainst brute force), infer (state inference only) or brute (brute force only)" << std::endl;
+    std::cout << "\t-s\n\t\tUse linear time sliding window state inference for every PRNG (otherwise the planner" << std::endl;
+    std::cout << "\t\tuses it where classic inference can't predict or would take over " << INFERENCE_SECONDS << " seconds)" << std::endl;
+    std::cout << "\t-e\n\t\tIterative deepening: brute force the whole seed range at depth " << FIRST_TIER_DEPTH << " first, then" << std::endl;
+    std::cout << "\t\tat " << TIER_GROWTH << " times the depth each pass until the -d depth is reached (otherwise the" << std::endl;
+    std::cout << "\t\tplanner deepens when a full depth search would take over " << DEEPENING_SECONDS << " seconds, unless" << std::endl;
+    std::cout << "\t\t-m is given)" << std::endl;
     std::cout << "" << std::endl;
 }
 
 
-/* Yeah lots of parameters, but such is the life of a thread */
-void BruteForce(const unsigned int id, bool& isCompleted, std::vector<std::vector<Seed>* > *answers,
-        std::vector<uint32_t>* status, double minimumConfidence, uint32_t startingSeed, uint32_t endingSeed,
-        uint32_t depth, std::string rng)
+/* How many of a tier's chunks lie closer than distance to one of its hint chunks */
+uint64_t ChunksNearHints(const SearchTier& tier, uint64_t distance)
+{
+    if (distance == 0)
+    {
+        return 0;
+    }
+
+    /* The hints are sorted, so the intervals around them only ever overlap the previous one */
+    uint64_t count = 0;
+    uint64_t covered = 0;  // End of the union of intervals so far, exclusive
+    for (unsigned int index = 0; index < tier.hintChunks.size(); ++index)
+    {
+        uint64_t hint = tier.hintChunks[index];
+        uint64_t first = std::max((hint < distance - 1) ? 0 : hint - distance + 1, covered);
+        uint64_t last = std::min(hint + distance, tier.chunkCount);
+        if (first < last)
+        {
+            count += last - first;
+            covered = last;
+        }
+    }
+    return count;
+}
+
+/*
+    Which chunk of a tier is the order'th one to search. Without hints that's
+    just the order. With hints, chunks go in order of their distance from the
+    nearest hint chunk, so the time to a hit depends on how far the seed is
+    from a hint rather than on the size of the range. This is worked out from
+    the index each time (a binary search over the distance, then a look at the
+    few chunks at that exact distance), so no chunk order is ever stored.
+*/
+uint64_t RadialChunk(const SearchTier& tier, uint64_t order)
+{
+    if (tier.hintChunks.empty())
+    {
+        return order;
+    }
+
+    /* The largest distance with no more than order chunks closer than it */
+    uint64_t lower = 0;
+    uint64_t upper = tier.chunkCount;
+    while (lower < upper)
+    {
+        uint64_t middle = lower + (upper - lower + 1) / 2;
+        if (ChunksNearHints(tier, middle) <= order)
+        {
+            lower = middle;
+        }
+        else
+        {
+            upper = middle - 1;
+        }
+    }
+    uint64_t distance = lower;
+    uint64_t rank = order - ChunksNearHints(tier, distance);
+
+    std::vector<uint64_t> candidates;
+    for (unsigned int index = 0; index < tier.hintChunks.size(); ++index)
+    {
+        uint64_t hint = tier.hintChunks[index];
+        if (distance <= hint)
+        {
+            candidates.push_back(hint - distance);
+        }
+        if (hint + distance < tier.chunkCount)
+        {
+            candidates.push_back(hint + distance);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    for (unsigned int index = 0; index < candidates.size(); ++index)
+    {
+        /* Skip chunks that are closer to some other hint, they went out already */
+        bool isCloser = false;
+        for (unsigned int hint = 0; hint < tier.hintChunks.size() && !isCloser; ++hint)
+        {
+            uint64_t other = tier.hintChunks[hint];
+            isCloser = ((candidates[index] < other) ? other - candidates[index] : candidates[index] - other) < distance;
+        }
+        if (!isCloser && rank-- == 0)
+        {
+            return candidates[index];
+        }
+    }
+    return order;  // Unreachable while order < tier.chunkCount
+}
+
+/* True once the run has gone past its deadline, which stops state inference as well as the brute force */
+bool IsPastDeadline(const SearchJob *job)
+{
+    return job->hasDeadline && job->deadline <= steady_clock::now();
+}
+
+/* True once the brute force has run past the deadline or used up its generator steps */
+bool IsOverBudget(const SearchJob *job)
+{
+    if (job->stepBudget != 0 && job->stepBudget <= job->stepsUsed)
+    {
+        return true;
+    }
+    return IsPastDeadline(job);
+}
+
+/* The full match of one filtered seed */
+/*
+    With iterative deepening every tier rescans the whole range, so a seed short
+    of 100% comes up again at each deeper tier. It was recorded at the tier
+    before if that tier's filter let it through and it passed the verifier
+    there too. Returns the confidence it was recorded with, or -1 if it wasn't.
+*/
+double ShallowerConfidence(SearchJob *job, SearchWorkspace *workspace, const Seed& seed, uint32_t depth)
+{
+    uint32_t shallower = 0;
+    for (unsigned int index = 1; index < job->tiers.size(); ++index)
+    {
+        if (job->tiers[index].depth == depth)
+        {
+            shallower = job->tiers[index - 1].depth;
+        }
+    }
+    uint32_t observedSize = observedOutputs.size();
+    if (shallower == 0 || FilterDepth(shallower, observedSize, job->minimumConfidence) <= seed.offset)
+    {
+        return -1.0;
+    }
+
+    SearchChunk chunk = {workspace->observed, observedSize, shallower, job->minimumConfidence,
+                         seed.engine, seed.value, seed.value, NULL};
+    workspace->verifiers[seed.engine](chunk, &workspace->shallower);
+    double confidence = workspace->shallower.empty() ? -1.0 : workspace->shallower[0].confidence;
+    workspace->shallower.clear();
+    return confidence;
+}
+
+void Verify(SearchJob *job, SearchWorkspace *workspace, const Candidate& candidate, std::atomic<bool>& isCompleted)
+{
+    TraceSpan span("verify", "search");
+    span.label(job->traceLabels[candidate.engine]);
+    span.arg("seed", candidate.seed);
+    SearchChunk chunk = {workspace->observed, (uint32_t) observedOutputs.size(), candidate.depth, job->minimumConfidence,
+                         candidate.engine, candidate.seed, candidate.seed, &workspace->best};
+    if (workspace->verifiers[candidate.engine](chunk, &workspace->answers))
+    {
+        job->isFound = true;
+        isCompleted = true;  // Some other thread may stop now, we found the seed
+    }
+    for (unsigned int index = 0; index < workspace->answers.size(); ++index)
+    {
+        /* Only recorded again if a deeper tier raised its confidence */
+        double shallower = ShallowerConfidence(job, workspace, workspace->answers[index], candidate.depth);
+        if (workspace->answers[index].confidence <= shallower)
+        {
+            continue;
+        }
+        if (shallower < 0.0)
+        {
+            workspace->top.add(workspace->answers[index]);
+        }
+        else
+        {
+            workspace->top.raise(workspace->answers[index]);
+        }
+        if (job->stream != NULL)
+        {
+            job->stream->push(workspace->answers[index]);
+        }
+        if (job->spill != NULL)
+        {
+            workspace->spilled.push_back(workspace->answers[index]);
+            workspace->spilled.back().engine = job->spillIds[workspace->answers[index].engine];
+        }
+    }
+    workspace->answers.clear();
+    if (SPILL_BATCH_SIZE <= workspace->spilled.size())
+    {
+        job->spill->write(workspace->spilled);
+        workspace->spilled.clear();
+    }
+}
+
+/* Verify one waiting candidate, false if there are none */
+bool VerifyNext(SearchJob *job, SearchWorkspace *workspace, std::atomic<bool>& isCompleted)
+{
+    Candidate candidate;
+    if (!job->candidates.pop(&candidate))
+    {
+        return false;
+    }
+    Verify(job, workspace, candidate, isCompleted);
+    return true;
+}
+
+/*
+    Filter one chunk of seeds against every PRNG, false once there are no
+    chunks left or the budget has run out. The budget is checked before a
+    chunk is taken rather than during it, so every chunk handed out gets
+    finished and the covered region is exactly the chunks handed out.
+    Waiting candidates are verified before any new chunk is filtered, which
+    keeps the queue short; if it's full anyway, the filtering worker
+    verifies its own survivors on the spot.
+*/
+bool SearchNext(SearchJob *job, SearchWorkspace *workspace, std::atomic<bool>& isCompleted)
+{
+    if (VerifyNext(job, workspace, isCompleted))
+    {
+        return true;
+    }
+    if (IsOverBudget(job))
+    {
+        return false;
+    }
+    uint64_t chunkIndex = job->nextChunk++;
+    if (job->chunkCount <= chunkIndex)
+    {
+        return false;  // Nothing left to hand out
+    }
+
+    unsigned int tierIndex = 0;
+    while (job->tiers[tierIndex].firstChunk + job->tiers[tierIndex].chunkCount <= chunkIndex)
+    {
+        tierIndex++;
+    }
+    const SearchTier& tier = job->tiers[tierIndex];
+    chunkIndex = RadialChunk(tier, chunkIndex - tier.firstChunk);
+    TraceSpan span("chunk", "search");
+    span.arg("chunk", chunkIndex);
+    span.arg("depth", tier.depth);
+
+    SearchChunk chunk;
+    chunk.observed = workspace->observed;
+    chunk.observedSize = observedOutputs.size();
+    chunk.depth = FilterDepth(tier.depth, chunk.observedSize, job->minimumConfidence);
+    chunk.minimumConfidence = job->minimumConfidence;
+    chunk.firstSeed = (uint64_t) job->lowerBoundSeed + chunkIndex * tier.chunkSize;
+    chunk.lastSeed = std::min(chunk.firstSeed + tier.chunkSize, (uint64_t) job->lowerBoundSeed + job->seedCount) - 1;
+    chunk.best = NULL;
+
+    /* Every PRNG scans the same chunk back to back, so the observed values stay in cache */
+    for (unsigned int engine = 0; engine < workspace->filters.size() && !isCompleted; ++engine)
+    {
+        chunk.engine = engine;
+        workspace->survivors.clear();
+        TraceSpan filterSpan("filter", "search");
+        filterSpan.label(job->traceLabels[engine]);
+        filterSpan.arg("first seed", chunk.firstSeed);
+        TelemetryTotals delta;
+        uint64_t cycles = 0;
+        uint64_t instructions = 0;
+        bool isCounted = workspace->counters != NULL && workspace->counters->read(&cycles, &instructions);
+        steady_clock::time_point start = steady_clock::now();
+
+        workspace->filters[engine](chunk, &workspace->survivors);
+
+        delta.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(steady_clock::now() - start).count();
+        if (isCounted && workspace->counters->read(&delta.cycles, &delta.instructions))
+        {
+            delta.cycles -= cycles;
+            delta.instructions -= instructions;
+        }
+        delta.seeds = chunk.lastSeed - chunk.firstSeed + 1;
+        delta.outputs = delta.seeds * chunk.depth;
+        delta.rejects = delta.seeds - workspace->survivors.size();
+        job->telemetry->add(workspace->id, engine, delta);
+        job->stepsUsed += delta.outputs;
+
+        for (unsigned int index = 0; index < workspace->survivors.size(); ++index)
+        {
+            Candidate candidate = {engine, workspace->survivors[index], tier.depth};
+            if (!job->candidates.push(candidate))
+            {
+                Verify(job, workspace, candidate, isCompleted);
+            }
+        }
+    }
+    return true;
+}
+
+/* For easier testing, will generate a series of random numbers at a given seed */
+void GenerateSample(uint32_t seed, uint32_t depth, std::string rng)
 {
-    /* Each thread must have a local factory unless you like mutexes and/or segfaults */
     PRNGFactory factory;
     PRNG *generator = factory.getInstance(rng);
-    answers->at(id) = new std::vector<Seed>;
+    generator->seed(seed);
 
-    for (uint32_t seedIndex = startingSeed; seedIndex <= endingSeed; ++seedIndex)
+    uint32_t block[KERNEL_BLOCK_SIZE];
+    for (uint32_t offset = 0; offset < depth; offset += KERNEL_BLOCK_SIZE)
     {
-        generator->seed(seedIndex);
+        uint32_t count = std::min(KERNEL_BLOCK_SIZE, depth - offset);
+        generator->fill(block, count);
+        for (uint32_t index = 0; index < count; ++index)
+        {
+            std::cout << block[index] << '\n';
+        }
+    }
+    std::cout.flush();
+    delete generator;
+}
 
-        uint32_t matchesFound = 0;
-        for (uint32_t index = 0; index < depth; index++)
+/* A rate in a handful of characters, e.g. 12.3M */
+std::string FormatRate(double rate)
+{
+    const char *units[] = {"", "K", "M", "G"};
+    unsigned int unit = 0;
+    while (1000.0 <= rate && unit < 3)
+    {
+        rate /= 1000.0;
+        unit++;
+    }
+    std::ostringstream text;
+    text.precision(3);
+    text << rate << units[unit];
+    return text.str();
+}
+
+/*
+    One refresh of the progress line. Each PRNG's rate is per thread, over the
+    time spent in its filter. inferred is how far state inference has got, or
+    negative if it isn't racing the brute force.
+*/
+void PrintProgress(const SearchJob *job, double percent, double inferred, double elapsed)
+{
+    std::cout << "\rProgress: " << CLEAR.c_str() << DEBUG.c_str() << percent << "%";
+    std::cout << " (" << (int) elapsed << " seconds";
+    if (0.0 < percent)
+    {
+        std::cout << ", ETA " << (int) (elapsed * (100.0 - percent) / percent) << " seconds";
+    }
+    std::cout << ")";
+    if (0.0 <= inferred)
+    {
+        std::cout << ", inference " << inferred << "%";
+    }
+    const char *separator = " ";
+    for (unsigned int engine = 0; engine < job->rngs.size(); ++engine)
+    {
+        TelemetryTotals totals = job->telemetry->engineTotals(engine);
+        if (totals.nanoseconds == 0)
+        {
+            continue;
+        }
+        std::cout << separator << job->rngs[engine] << " " << FormatRate(totals.seeds * 1e9 / totals.nanoseconds) << " seeds/s";
+        if (0 < totals.cycles)
         {
-            uint32_t nextRand = generator->random();
-            uint32_t observed = observedOutputs[matchesFound];
+            std::cout << " IPC " << FormatRate((double) totals.instructions / (double) totals.cycles);
+        }
+        separator = ", ";
+    }
+    std::cout.flush();
+}
 
-            if (observed == nextRand)
+/*
+    Reports progress until the brute force and state inference are both done,
+    out of budget, or until one of them wins the race. The line follows the
+    brute force, with inference alongside it, or inference alone when there's
+    nothing to brute force. It also writes out the result stream's hits as
+    they come in, and a progress record every STREAM_PROGRESS_SECONDS.
+*/
+void StatusThread(std::vector<std::thread>& pool, std::atomic<bool>& isCompleted, const SearchJob *job,
+        const InferenceJob *inference)
+{
+    double percent = 0;
+    double inferred = 0;
+    uint64_t totalWork = job->seedCount * job->rngs.size() * job->tiers.size();
+    steady_clock::time_point start = steady_clock::now();
+    steady_clock::time_point nextRecord = start;
+    while (!isCompleted && (percent < 100.0 || inferred < 100.0) && !IsPastDeadline(job) && 0 < job->activeWorkers)
+    {
+        {
+            TraceSpan span("status", "status");
+            uint64_t seeds = job->telemetry->totals().seeds;
+            percent = (0 < totalWork) ? ((double) seeds / (double) totalWork) * 100.0 : 100.0;
+            inferred = (0 < inference->taskCount) ? ((double) inference->tasksDone / (double) inference->taskCount) * 100.0 : 100.0;
+            double elapsed = std::chrono::duration<double>(steady_clock::now() - start).count();
+            if (0 < totalWork)
             {
-                matchesFound++;
-                if (matchesFound == observedOutputs.size())
-                {
-                    break;  // This seed is a winner if we get to the end
-                }
+                PrintProgress(job, percent, (0 < inference->taskCount) ? inferred : -1.0, elapsed);
             }
+            else
+            {
+                PrintProgress(job, inferred, -1.0, elapsed);
+            }
+            if (job->stream != NULL && nextRecord <= steady_clock::now())
+            {
+                job->stream->progress(percent, seeds);
+                nextRecord += duration_cast<steady_clock::duration>(std::chrono::duration<double>(STREAM_PROGRESS_SECONDS));
+            }
+        }
+
+        /* Refresh every 150ms, but notice straight away when the workers are done */
+        for (unsigned int slice = 0; slice < 30 && !isCompleted && 0 < job->activeWorkers; ++slice)
+        {
+            std::this_thread::sleep_for(milliseconds(5));
+            if (job->stream != NULL)
+            {
+                job->stream->drain();
+            }
+        }
+    }
+    std::cout << "\r" << CLEAR.c_str();
+}
+
+/* Rough seconds it takes the search kernel to test one seed, measured on a handful of seeds */
+double EstimateSeedCost(const std::string& rng, const std::string& variant, uint32_t depth)
+{
+    PRNGFactory factory;
+    FilterKernel filter = factory.getKernel(rng, variant).filter;
+
+    /* Every seed is walked to the full depth whether it gets through or not */
+    std::vector<uint32_t> impossible(2, 0);
+    std::vector<uint32_t> ignored;
+    SearchChunk chunk = {&impossible[0], (uint32_t) impossible.size(), depth, 100.0, 0, 0, CALIBRATION_SEEDS - 1, NULL};
+
+    steady_clock::time_point start = steady_clock::now();
+    filter(chunk, &ignored);
+    double elapsed = std::chrono::duration<double>(steady_clock::now() - start).count();
+    return elapsed / CALIBRATION_SEEDS;
+}
+
+/*
+    The depths to scan the whole seed range at. Without deepening that's just
+    the requested depth. With it, the range is scanned at FIRST_TIER_DEPTH, then
+    again TIER_GROWTH times deeper each time up to the requested depth, so hits
+    near the start of the stream turn up after a fraction of the work. A seed's
+    outputs can't be kept between tiers (there are billions of seeds), so each
+    tier regenerates from the seed. Tiers stop short of a TIER_GROWTH'th of the
+    requested depth, so the shallower tiers add at most 1/7 to the full scan.
+*/
+std::vector<uint32_t> DepthTiers(uint32_t depth, bool isDeepening)
+{
+    std::vector<uint32_t> depths;
+    for (uint32_t tier = FIRST_TIER_DEPTH; isDeepening && tier <= depth / TIER_GROWTH; tier *= TIER_GROWTH)
+    {
+        depths.push_back(tier);
+    }
+    depths.push_back(depth);
+    return depths;
+}
+
+/*
+    Cut the seed range into chunks that each take about CHUNK_SECONDS to test
+    against every PRNG, so that a fast PRNG doesn't finish its share long before
+    a slow one and leave cores idle. Within a chunk the cheapest PRNG goes first.
+    Each depth tier gets its own chunk size, since a seed costs more the deeper it goes.
+*/
+void PlanChunks(SearchJob *job, const std::vector<uint32_t>& depths, unsigned int threads)
+{
+    std::vector<std::pair<double, std::string> > costs;
+    for (unsigned int index = 0; index < job->rngs.size(); ++index)
+    {
+        double cost = EstimateSeedCost(job->rngs[index], job->variant, depths.back());
+        costs.push_back(std::make_pair(cost, job->rngs[index]));
+    }
+    std::sort(costs.begin(), costs.end());
+    for (unsigned int index = 0; index < costs.size(); ++index)
+    {
+        job->rngs[index] = costs[index].second;
+    }
+
+    uint64_t fairShare = (job->seedCount + threads - 1) / threads;
+    job->tiers.clear();
+    job->chunkCount = 0;
+    for (unsigned int tierIndex = 0; tierIndex < depths.size(); ++tierIndex)
+    {
+        double totalCost = 0.0;
+        for (unsigned int index = 0; index < job->rngs.size(); ++index)
+        {
+            bool isFullDepth = (tierIndex + 1 == depths.size());
+            totalCost += isFullDepth ? costs[index].first : EstimateSeedCost(job->rngs[index], job->variant, depths[tierIndex]);
+        }
+
+        SearchTier tier;
+        uint64_t chunkSize = (0.0 < totalCost) ? (uint64_t) (CHUNK_SECONDS / totalCost) : fairShare;
+        tier.depth = depths[tierIndex];
+        tier.chunkSize = std::max((uint64_t) 1, std::min(chunkSize, fairShare));
+        tier.chunkCount = (job->seedCount + tier.chunkSize - 1) / tier.chunkSize;
+        tier.firstChunk = job->chunkCount;
+        for (unsigned int index = 0; index < job->hints.size(); ++index)
+        {
+            uint64_t offset = std::max(job->hints[index], job->lowerBoundSeed) - job->lowerBoundSeed;
+            tier.hintChunks.push_back(std::min(offset / tier.chunkSize, tier.chunkCount - 1));
+        }
+        std::sort(tier.hintChunks.begin(), tier.hintChunks.end());
+        tier.hintChunks.erase(std::unique(tier.hintChunks.begin(), tier.hintChunks.end()), tier.hintChunks.end());
+        job->tiers.push_back(tier);
+        job->chunkCount += tier.chunkCount;
+    }
+    job->nextChunk = 0;
+}
+
+/*
+    Check the observed outputs against the relations every registered PRNG
+    must satisfy. Each check is a single linear pass, so this is far cheaper
+    than even the smallest brute force and tells us which PRNGs look likely,
+    and which can have their state inferred. The relations only hold between
+    consecutive outputs, so a PRNG that fails them is still brute forced
+    (which copes with gaps in the capture), just not inferred.
+*/
+std::vector<EngineFit> DetectEngines(double fingerprintConfidence)
+{
+    TraceSpan span("fingerprint", "setup");
+    std::cout << INFO << "Fingerprinting " << observedOutputs.size() << " observed value(s)" << std::endl;
+
+    PRNGFactory factory;
+    std::vector<std::string> names = factory.getNames();
+    std::vector<EngineFit> fits;
+    for (unsigned int index = 0; index < names.size(); ++index)
+    {
+        PRNG *generator = factory.getInstance(names[index]);
+        Fingerprint fingerprint = generator->fingerprint(observedOutputs);
+
+        EngineFit fit;
+        fit.name = names[index];
+        fit.isTested = (0 < fingerprint.tested);
+        fit.score = fit.isTested ? ((double) fingerprint.satisfied / (double) fingerprint.tested) * 100.0 : 0.0;
+        fit.isPlausible = !fit.isTested || fingerprintConfidence <= fit.score;
+        fit.canInferState = fit.isPlausible && generator->getStateSize() < observedOutputs.size();
+        fits.push_back(fit);
+        delete generator;
+
+        if (!fit.isTested)
+        {
+            std::cout << DEBUG << fit.name << ": not enough values to test, assuming plausible" << std::endl;
+        }
+        else
+        {
+            std::cout << (fit.isPlausible ? SUCCESS : DEBUG) << fit.name << ": " << fit.score << "% of "
+                      << fingerprint.tested << " relation(s) hold";
+            if (fit.isPlausible)
+            {
+                std::cout << " (brute force" << (fit.canInferState ? ", state inference)" : ")");
+            }
+            else
+            {
+                std::cout << " (not its consecutive outputs, brute force only)";
+            }
+            std::cout << std::endl;
+        }
+    }
+    return fits;
+}
+
+void PrintState(PRNG *generator)
+{
+    uint32_t outSeed = 0;
+    if(generator->reverseToSeed(&outSeed, 10000))
+    {
+        /* We win! */
+        std::cout << SUCCESS << "Found seed " << outSeed << std::endl;
+    }
+    else
+    {
+        std::cout << SUCCESS << "Found state: " << std::endl;
+        OutputSpan state = generator->getState();
+        for(uint32_t j = 0; j < state.size(); j++)
+        {
+            std::cout << SUCCESS << state[j] << std::endl;
+        }
+    }
+}
+
+/*
+    Rebuild the state from the window of observed values at the given offset,
+    tune it with the values either side, and count how many of those values
+    the tuned state predicts.
+*/
+uint32_t ScoreWindow(PRNG *generator, uint32_t window, std::vector<uint32_t>& predictions)
+{
+    OutputSpan observed(observedOutputs);
+    uint32_t stateSize = generator->getStateSize();
+
+    /* Make predictions based on the state */
+    OutputSpan evidenceForward = observed.subspan(0, window);
+    OutputSpan evidenceBackward = observed.subspan(window + stateSize + 1, observed.size() - (window + stateSize + 1));
+    generator->setState(observed.subspan(window, stateSize));
+    {
+        TraceSpan span("tune", "inference");
+        generator->tune(evidenceForward, evidenceBackward);
+    }
+
+    /* Test the prediction against the rest of the observed data */
+    /* Forward */
+    uint32_t predicted = generator->predictForward(&predictions[0], (observedOutputs.size() - stateSize) - window);
+    uint32_t matchesFound = 0;
+    uint32_t index_pred = 0;
+    uint32_t index_obs = window + stateSize;
+    while(index_obs < observedOutputs.size() && index_pred < predicted)
+    {
+        if(observedOutputs[index_obs] == predictions[index_pred])
+        {
+            matchesFound++;
+            index_obs++;
+        }
+        index_pred++;
+    }
+
+    /* Backward, from the output just before the state, which predictBackward() writes last */
+    predicted = generator->predictBackward(&predictions[0], window);
+    index_pred = predicted;
+    index_obs = window;
+    while(index_obs > 0 && index_pred > 0)
+    {
+        if(observedOutputs[index_obs - 1] == predictions[index_pred - 1])
+        {
+            matchesFound++;
+            index_obs--;
+        }
+        index_pred--;
+    }
+    return matchesFound;
+}
+
+/* Note which observed values in one segment were predicted by the window before them */
+void SlideSegment(PRNG *generator, uint32_t segment, uint32_t segmentSize, std::vector<uint32_t> *runs)
+{
+    OutputSpan observed(observedOutputs);
+    uint32_t stateSize = generator->getStateSize();
+    uint32_t first = stateSize + segment * segmentSize;
+    uint32_t last = std::min(first + segmentSize, (uint32_t) observed.size());
+
+    generator->beginSlide(observed.subspan(first - stateSize, stateSize));
+    for (uint32_t index = first; index < last; ++index)
+    {
+        runs->at(index) = generator->slide(observed[index]) ? 1 : 0;
+    }
+}
+
+/* Where the best scoring sliding window lies, scored from the runs of predictions noted by the workers.
+    runs[j] starts out as whether observed[j] was predicted, and one pass backwards turns it into the
+    length of the run of predictions starting at j. A window then explains the run either side of it,
+    and the backward runs are carried along while the windows are scored in order. */
+StateGuess BestSlidingWindow(uint32_t stateSize, std::vector<uint32_t>& runs)
+{
+    uint32_t observedSize = observedOutputs.size();
+    uint32_t relations = observedSize - stateSize;
+    for (uint32_t index = observedSize; stateSize < index; --index)
+    {
+        if (runs[index - 1])
+        {
+            runs[index - 1] = runs[index] + 1;
+        }
+    }
+
+    StateGuess best;
+    uint32_t backward = 0;
+    for (uint32_t window = 0; window < relations; ++window)
+    {
+        uint32_t last = window + stateSize - 1;
+        backward = (stateSize <= last && runs[last]) ? backward + 1 : 0;
+        uint32_t matchesFound = backward + runs[window + stateSize];
+        if (best.matches < matchesFound)
+        {
+            best.matches = matchesFound;
+            best.window = window;
+        }
+
+        /* The first window explaining everything wins, there's no need to score the rest */
+        if (matchesFound == relations)
+        {
+            break;
+        }
+    }
+    return best;
+}
+
+/* Whether the state built from the window at this offset gives back every observed value, in order */
+bool ReproducesEvidence(PRNG *generator, uint32_t window, std::vector<uint32_t>& predictions)
+{
+    uint32_t stateSize = generator->getStateSize();
+    uint32_t after = observedOutputs.size() - stateSize - window;
+    if (generator->predictForward(&predictions[0], after) != after ||
+        !std::equal(predictions.begin(), predictions.begin() + after, observedOutputs.begin() + window + stateSize))
+    {
+        return false;
+    }
+    return window == 0 || (generator->predictBackward(&predictions[0], window) == window &&
+                           std::equal(predictions.begin(), predictions.begin() + window, observedOutputs.begin()));
+}
+
+/*
+    Claim the win for a state, unless another worker got there first. A score
+    can be fooled (it skips over predictions that weren't observed), so the
+    state is checked against the evidence once more before it stops the brute
+    force it's racing.
+*/
+void SolvedState(InferenceJob *job, std::atomic<bool>& isCompleted, PRNG *generator, unsigned int engine,
+                 uint32_t window, std::vector<uint32_t>& predictions)
+{
+    if (!ReproducesEvidence(generator, window, predictions))
+    {
+        return;
+    }
+    bool isFirst = false;
+    if (job->isFound.compare_exchange_strong(isFirst, true))
+    {
+        job->solved = generator->clone();
+        job->solvedEngine = engine;
+        isCompleted = true;
+    }
+}
+
+/*
+    This is the "smarter" method of breaking RNGs. We use consecutive integers
+    to infer information about the internal state of the RNG. Using this 
+    method, however, we won't typically recover an actual seed value. 
+    But the effect is the same.
+
+    Every window is rebuilt and tuned independently, so the windows of all the
+    PRNGs are spread over the worker threads. For PRNGs in sliding mode (linear
+    time, for long captures) the sliding pass is cut into segments instead, each
+    primed with the window just before it.
+*/
+void PrepareInference(InferenceJob *job, const std::vector<std::string>& rngs, const std::vector<bool>& sliding)
+{
+    PRNGFactory factory;
+    job->segmentSize = SLIDING_SEGMENT_SIZE;
+    job->taskCount = 0;
+    job->nextTask = 0;
+    job->tasksDone = 0;
+    job->isFound = false;
+    job->solved = NULL;
+    job->solvedEngine = 0;
+
+    for (unsigned int index = 0; index < rngs.size(); ++index)
+    {
+        PRNG *generator = factory.getInstance(rngs[index]);
+        uint32_t stateSize = generator->getStateSize();
+        if(observedOutputs.size() <= stateSize)
+        {
+            std::cout << WARN << "Not enough observed values to perform state inference on " << rngs[index] << "." << std::endl;
+            std::cout << WARN << "Try again with more than " << stateSize << " values" << std::endl;
+            delete generator;
+            continue;
+        }
+
+        /* Provide additional evidence for tuning on PRNGs that require it */
+        generator->setEvidence(observedOutputs);
+
+        bool isSliding = sliding[index];
+        uint32_t relations = observedOutputs.size() - stateSize;
+        uint32_t units = isSliding ? (relations + job->segmentSize - 1) / job->segmentSize : relations;
+        job->names.push_back(rngs[index]);
+        job->traceLabels.push_back(Trace::intern(rngs[index]));
+        job->prototypes.push_back(generator);
+        job->sliding.push_back(isSliding);
+        job->unitCounts.push_back(units);
+        job->runs.push_back(std::vector<uint32_t>(isSliding ? observedOutputs.size() + 1 : 0, 0));
+        job->taskCount = std::max(job->taskCount, (uint64_t) units);
+    }
+    job->taskCount *= job->prototypes.size();
+
+    /* Whoever slides the last segment of a PRNG scores its windows */
+    std::vector<std::atomic<uint32_t> > segmentsLeft(job->prototypes.size());
+    for (unsigned int engine = 0; engine < job->prototypes.size(); ++engine)
+    {
+        segmentsLeft[engine] = job->unitCounts[engine];
+    }
+    job->segmentsLeft.swap(segmentsLeft);
+    job->slidingBest.assign(job->prototypes.size(), StateGuess());
+
+    for (unsigned int engine = 0; engine < job->prototypes.size(); ++engine)
+    {
+        std::cout << INFO << "Trying " << (job->sliding[engine] ? "sliding window " : "") << "state inference on "
+                  << job->names[engine] << std::endl;
+    }
+}
+
+/*
+    Score one window (or slide one segment) of one PRNG, false once there is
+    nothing left to do. Windows of every PRNG are handed out round robin, so
+    all PRNGs make progress together and the first verified state stops every
+    worker, whichever PRNG it belongs to.
+*/
+bool InferNext(InferenceJob *job, InferenceWorkspace *workspace, std::atomic<bool>& isCompleted)
+{
+    unsigned int engines = job->prototypes.size();
+    if (job->isFound || engines == 0)
+    {
+        return false;
+    }
+    if (workspace->generators.empty())
+    {
+        for (unsigned int engine = 0; engine < engines; ++engine)
+        {
+            workspace->generators.push_back(job->prototypes[engine]->clone());
+        }
+        workspace->predictions.resize(observedOutputs.size());
+        workspace->best.assign(engines, StateGuess());
+    }
+
+    uint64_t task = job->nextTask++;
+    if (job->taskCount <= task)
+    {
+        return false;
+    }
+    unsigned int engine = task % engines;
+    uint32_t unit = task / engines;
+    PRNG *generator = workspace->generators[engine];
+    uint32_t stateSize = generator->getStateSize();
+    if (job->unitCounts[engine] <= unit)
+    {
+        job->tasksDone++;
+        return true;  // This PRNG has a larger state, so fewer windows
+    }
+
+    TraceSpan span(job->sliding[engine] ? "slide segment" : "window", "inference");
+    span.label(job->traceLabels[engine]);
+    span.arg(job->sliding[engine] ? "segment" : "window", unit);
+    if (job->sliding[engine])
+    {
+        SlideSegment(generator, unit, job->segmentSize, &job->runs[engine]);
+        if (--job->segmentsLeft[engine] == 0)
+        {
+            TraceSpan scoring("best window", "inference");
+            scoring.label(job->traceLabels[engine]);
+            StateGuess best = BestSlidingWindow(stateSize, job->runs[engine]);
+
+            /* The relations holding only says the window could be a state (glibc's always do, give
+                or take the lost LSBs), so it's rebuilt and tuned, and scored on what it predicts */
+            if (0 < best.matches)
+            {
+                best.matches = ScoreWindow(generator, best.window, workspace->predictions);
+                OutputSpan state = generator->getState();
+                best.state.assign(state.begin(), state.end());
+            }
+            job->slidingBest[engine] = best;
+            if (best.matches == observedOutputs.size() - stateSize)
+            {
+                SolvedState(job, isCompleted, generator, engine, best.window, workspace->predictions);
+            }
+        }
+        job->tasksDone++;
+        return true;
+    }
+
+    uint32_t matchesFound = ScoreWindow(generator, unit, workspace->predictions);
+    job->tasksDone++;
+    if (matchesFound == observedOutputs.size() - stateSize)
+    {
+        SolvedState(job, isCompleted, generator, engine, unit, workspace->predictions);
+        if (job->isFound)
+        {
+            return false;
+        }
+    }
+    if (workspace->best[engine].matches < matchesFound)
+    {
+        OutputSpan state = generator->getState();
+        workspace->best[engine].matches = matchesFound;
+        workspace->best[engine].window = unit;
+        workspace->best[engine].state.assign(state.begin(), state.end());
+    }
+    return true;
+}
+
+/*
+    Print the verified state, or else the best guess for each PRNG. If the
+    brute force found the seed first, inference was cancelled part way, so its
+    guesses mean nothing and aren't shown.
+*/
+bool ReportInference(InferenceJob *job, std::vector<InferenceWorkspace>& workspaces, bool isSearchFound)
+{
+    bool isInferred = (job->solved != NULL);
+    if (isInferred)
+    {
+        std::cout << SUCCESS << job->names[job->solvedEngine] << ": state predicts every observed value" << std::endl;
+        PrintState(job->solved);
+        delete job->solved;
+    }
+    else if (!job->prototypes.empty() && isSearchFound)
+    {
+        std::cout << INFO << "State inference cancelled, the brute force found the seed first" << std::endl;
+    }
+
+    for (unsigned int engine = 0; engine < job->prototypes.size() && !isInferred && !isSearchFound; ++engine)
+    {
+        PRNG *generator = job->prototypes[engine];
+        uint32_t stateSize = generator->getStateSize();
+
+        /* Analyze scores */
+        StateGuess best = job->slidingBest[engine];
+        for (unsigned int id = 0; id < workspaces.size(); ++id)
+        {
+            if (engine < workspaces[id].best.size() && best.matches < workspaces[id].best[engine].matches)
+            {
+                best = workspaces[id].best[engine];
+            }
+        }
+        if (0 < best.matches)
+        {
+            double highscore = (double)(best.matches * 100) / (double)(observedOutputs.size() - stateSize);
+            std::cout << SUCCESS << job->names[engine] << ": best state guess at offset " << best.window
+                      << ", with confidence of: " << highscore << "%" << std::endl;
+            for(uint32_t j = 0; j < best.state.size(); j++)
+            {
+                std::cout << SUCCESS << best.state[j] << std::endl;
+            }
+        }
+    }
+    if (!job->prototypes.empty() && !isInferred && !isSearchFound)
+    {
+        std::cout << INFO << "State Inference failed" << std::endl;
+    }
+
+    for (unsigned int engine = 0; engine < job->prototypes.size(); ++engine)
+    {
+        delete job->prototypes[engine];
+    }
+    for (unsigned int id = 0; id < workspaces.size(); ++id)
+    {
+        for (unsigned int engine = 0; engine < workspaces[id].generators.size(); ++engine)
+        {
+            delete workspaces[id].generators[engine];
+        }
+    }
+    return isInferred;
+}
+
+/* The observed values on a NUMA node, copied by the first worker pinned there so the pages are local to it */
+const uint32_t* NodeReplica(SearchJob *job, unsigned int node)
+{
+    std::lock_guard<std::mutex> lock(job->replicaLock);
+    std::vector<uint32_t>& replica = job->replicas[node];
+    if (replica.empty())
+    {
+        replica.assign(observedOutputs.begin(), observedOutputs.end());
+    }
+    return &replica[0];
+}
+
+/*
+    Yeah lots of parameters, but such is the life of a thread. Every worker
+    races state inference against brute force: it takes whichever job it has
+    spent less time on so far, so both get an even share of the CPUs and the
+    answer comes as soon as the quicker of the two finds it. Either one
+    finding it sets isCompleted, which cancels the other.
+*/
+void Worker(const unsigned int id, std::atomic<bool>& isCompleted, InferenceJob *inference, SearchJob *search,
+        std::vector<InferenceWorkspace> *workspaces)
+{
+    std::ostringstream threadName;
+    threadName << "worker " << id;
+    Trace::nameThread(threadName.str());
+    TraceSpan lifetime("worker", "worker");  // Its start, against the main thread's spawn, shows thread startup
+
+    /* Pin first, so that whatever this worker allocates from here on lands on its own node */
+    const uint32_t *observed = &observedOutputs[0];
+    if (search->topology != NULL)
+    {
+        CpuSlot slot = search->topology->slot(id);
+        Topology::pin(slot.cpu);
+        observed = NodeReplica(search, slot.node);
+    }
+
+    /* Each thread must have a local factory unless you like mutexes and/or segfaults */
+    PRNGFactory factory;
+    SearchWorkspace workspace;
+    workspace.observed = observed;
+    for (unsigned int engine = 0; engine < search->rngs.size(); ++engine)
+    {
+        workspace.filters.push_back(factory.getKernel(search->rngs[engine], search->variant).filter);
+        workspace.verifiers.push_back(factory.getVerifier(search->rngs[engine]));
+    }
+    workspace.top = TopSeeds(search->resultLimit);
+    workspace.best = Seed();
+    workspace.id = id;
+    PerfCounters *counters = search->isCountingCycles ? new PerfCounters() : NULL;
+    workspace.counters = (counters != NULL && counters->isOpen()) ? counters : NULL;
+
+    bool isInferring = true;
+    bool isSearching = true;
+    double inferenceSeconds = 0.0;
+    double searchSeconds = 0.0;
+    while (!isCompleted && (isInferring || isSearching) && !IsPastDeadline(search))
+    {
+        bool isInferenceTurn = isInferring && (!isSearching || inferenceSeconds <= searchSeconds);
+        steady_clock::time_point start = steady_clock::now();
+        if (isInferenceTurn)
+        {
+            isInferring = InferNext(inference, &workspaces->at(id), isCompleted);
+        }
+        else
+        {
+            isSearching = SearchNext(search, &workspace, isCompleted);
+        }
+        double elapsed = std::chrono::duration<double>(steady_clock::now() - start).count();
+        (isInferenceTurn ? inferenceSeconds : searchSeconds) += elapsed;
+    }
+
+    /* Seeds that got through the filter are always verified, even out of budget */
+    while (!isCompleted && VerifyNext(search, &workspace, isCompleted))
+    {
+    }
+    if (search->spill != NULL)
+    {
+        search->spill->write(workspace.spilled);
+    }
+    std::swap(search->results[id], workspace.top);
+    search->bestFits[id] = workspace.best;
+    delete counters;
+    search->activeWorkers--;
+}
+
+void SpawnThreads(const unsigned int threads, SearchJob *search,
+        const std::vector<uint32_t>& depths, InferenceJob *inference, std::vector<InferenceWorkspace> *workspaces)
+{
+    std::atomic<bool> isCompleted(false);  // Flag to tell threads to stop working
+    {
+        TraceSpan span("plan chunks", "setup");
+        PlanChunks(search, depths, threads);
+    }
+    search->bestFits.assign(threads, Seed());
+    search->results.assign(threads, TopSeeds());
+    std::vector<std::string> names = PRNGFactory().getNames();
+    search->spillIds.clear();
+    for (unsigned int index = 0; index < search->rngs.size(); ++index)
+    {
+        search->spillIds.push_back(std::find(names.begin(), names.end(), search->rngs[index]) - names.begin());
+    }
+    if (search->stream != NULL)
+    {
+        search->stream->setNames(search->rngs);  // In the order PlanChunks left them
+    }
+    search->traceLabels.clear();
+    for (unsigned int index = 0; index < search->rngs.size(); ++index)
+    {
+        search->traceLabels.push_back(Trace::intern(search->rngs[index]));
+    }
+    if (search->seedCount == 0)
+    {
+        std::cout << INFO << "Spawning " << threads << " worker thread(s) ..." << std::endl;
+    }
+    else if (search->tiers.size() == 1)
+    {
+        std::cout << INFO << "Spawning " << threads << " worker thread(s) for " << search->chunkCount
+                  << " chunk(s) of " << search->tiers[0].chunkSize << " seed(s) ..." << std::endl;
+    }
+    else
+    {
+        std::cout << INFO << "Spawning " << threads << " worker thread(s) for " << search->tiers.size()
+                  << " depth tier(s) ..." << std::endl;
+        for (unsigned int index = 0; index < search->tiers.size(); ++index)
+        {
+            const SearchTier& tier = search->tiers[index];
+            std::cout << DEBUG << "Depth " << tier.depth << ": " << tier.chunkCount << " chunk(s) of "
+                      << tier.chunkSize << " seed(s)" << std::endl;
+        }
+    }
+    if (search->topology != NULL)
+    {
+        std::cout << DEBUG << "Pinning workers to CPU(s)";
+        for (unsigned int id = 0; id < threads && id < search->topology->cpuCount(); ++id)
+        {
+            std::cout << ((id == 0) ? " " : ", ") << search->topology->slot(id).cpu;
         }
-
-        if (isCompleted)
+        std::cout << " over " << search->topology->nodeCount() << " NUMA node(s)";
+        if (search->topology->cpuCount() < threads)
         {
-            break;  // Some other thread found the seed
+            std::cout << ", " << threads - search->topology->cpuCount() << " worker(s) sharing";
         }
+        std::cout << std::endl;
+    }
 
-        status->at(id) = seedIndex - startingSeed;
-        double confidence = ((double) matchesFound / (double) observedOutputs.size()) * 100.0;
-        if (minimumConfidence <= confidence)
+    std::vector<std::thread> pool(threads);
+    search->activeWorkers = threads;
+    {
+        TraceSpan span("spawn", "setup");
+        for (unsigned int id = 0; id < threads; ++id)
         {
-            Seed seed = {seedIndex, confidence};
-            answers->at(id)->push_back(seed);
+            pool[id] = std::thread(Worker, id, std::ref(isCompleted), inference, search, workspaces);
         }
-        if (matchesFound == observedOutputs.size())
-            isCompleted = true;  // We found the correct seed
     }
-    delete generator;
-}
-
-/* For easier testing, will generate a series of random numbers at a given seed */
-void GenerateSample(uint32_t seed, uint32_t depth, std::string rng)
-{
-    PRNGFactory factory;
-    PRNG *generator = factory.getInstance(rng);
-    generator->seed(seed);
-
-    for (unsigned int index = 0; index < depth; ++index)
+    StatusThread(pool, isCompleted, search, inference);
+    TraceSpan span("join", "setup");
+    for (unsigned int id = 0; id < pool.size(); ++id)
     {
-        std::cout << generator->random() << std::endl;
+        pool[id].join();
     }
-    delete generator;
 }
 
-void StatusThread(std::vector<std::thread>& pool, bool& isCompleted, uint32_t totalWork, std::vector<uint32_t> *status)
+/* What the brute force got through before its budget ran out, tier by tier */
+void ReportCoverage(const SearchJob *search)
 {
-    double percent = 0;
-    steady_clock::time_point start = steady_clock::now();
-    while (!isCompleted)
+    std::cout << WARN << "Brute force out of budget after " << search->stepsUsed << " generator step(s), stopped" << std::endl;
+    uint64_t handedOut = std::min((uint64_t) search->nextChunk, search->chunkCount);
+    for (unsigned int index = 0; index < search->tiers.size(); ++index)
     {
-        unsigned int sum = 0;
-        for (unsigned int index = 0; index < status->size(); ++index)
+        const SearchTier& tier = search->tiers[index];
+        uint64_t done = std::min(handedOut - std::min(handedOut, tier.firstChunk), tier.chunkCount);
+        uint64_t seeds = std::min(done * tier.chunkSize, search->seedCount);
+        std::cout << INFO << "Depth " << tier.depth << ": searched " << seeds << " of " << search->seedCount << " seed(s)";
+        if (seeds == 0 || seeds == search->seedCount)
         {
-            sum += status->at(index);
+            std::cout << std::endl;
         }
-        percent = ((double) sum / (double) totalWork) * 100.0;
-        isCompleted = (100.0 <= percent);
-        std::cout << "\rProgress: " << CLEAR.c_str() << DEBUG.c_str() << percent << "%";
-        std::cout << " (" << (int) duration_cast<seconds>(steady_clock::now() - start).count() << "seconds)";
-        std::cout.flush();
-        std::this_thread::sleep_for(milliseconds(150));
-    }
-    std::cout << "\r" << CLEAR.c_str();
-}
-
-/* Divide X number of seeds among Y number of threads */
-std::vector<uint32_t> DivisionOfLabor(uint32_t sizeOfWork, uint32_t numberOfWorkers)
-{
-    uint32_t work = sizeOfWork / numberOfWorkers;
-    uint32_t leftover = sizeOfWork % numberOfWorkers;
-    std::vector<uint32_t> labor(numberOfWorkers);
-    for (uint32_t index = 0; index < numberOfWorkers; ++index)
-    {
-        if (0 < leftover)
+        else if (tier.hintChunks.empty())
         {
-            labor[index] = work + 1;
-            --leftover;
+            std::cout << ", from " << search->lowerBoundSeed << " to " << search->lowerBoundSeed + seeds - 1 << std::endl;
         }
         else
         {
-            labor[index] = work;
+            /* Chunks went out by distance from the hints, so everything nearer than this is done */
+            uint64_t distance = 0;
+            while (ChunksNearHints(tier, distance + 1) <= done)
+            {
+                distance++;
+            }
+            std::cout << ", every seed within " << (distance == 0 ? 0 : (distance - 1) * tier.chunkSize)
+                      << " of a hint" << std::endl;
+        }
+    }
+
+    Seed best = {0, 0, 0.0, 0};
+    for (unsigned int id = 0; id < search->bestFits.size(); ++id)
+    {
+        if (best.confidence < search->bestFits[id].confidence)
+        {
+            best = search->bestFits[id];
         }
     }
-    return labor;
+    if (0.0 < best.confidence)
+    {
+        std::cout << INFO << "Best partial hit: seed " << best.value << " (" << search->rngs[best.engine]
+                  << ") with a confidence of " << best.confidence << '%' << std::endl;
+    }
 }
 
-void SpawnThreads(const unsigned int threads, std::vector<std::vector<Seed>* > *answers, double minimumConfidence,
-        uint32_t lowerBoundSeed, uint32_t upperBoundSeed, uint32_t depth, std::string rng)
+/* Seconds, as a rough duration a person can read at a glance */
+std::string FormatSeconds(double duration)
 {
-    bool isCompleted = false;  // Flag to tell threads to stop working
-    std::cout << INFO << "Spawning " << threads << " worker thread(s) ..." << std::endl;
-
-    std::vector<std::thread> pool(threads);
-    std::vector<uint32_t> *status = new std::vector<uint32_t>(threads);
-    std::vector<uint32_t> labor = DivisionOfLabor(upperBoundSeed - lowerBoundSeed, threads);
-    uint32_t startAt = lowerBoundSeed;
-    for (unsigned int id = 0; id < threads; ++id)
+    std::stringstream text;
+    if (duration < 0.01)
     {
-        uint32_t endAt = startAt + labor.at(id);
-        pool[id] = std::thread(BruteForce, id, std::ref(isCompleted), answers, status, minimumConfidence, startAt, endAt, depth, rng);
-        startAt += labor.at(id);
+        return "under 0.01s";
     }
-    StatusThread(pool, isCompleted, upperBoundSeed - lowerBoundSeed, status);
-    for (unsigned int id = 0; id < pool.size(); ++id)
+    if (duration < 60.0)
     {
-        pool[id].join();
+        text << std::fixed;
+        text.precision(duration < 10.0 ? 2 : 0);
+        text << duration << "s";
+        return text.str();
+    }
+    uint64_t total = (uint64_t) duration;
+    if (86400 <= total)
+    {
+        text << total / 86400 << "d " << (total % 86400) / 3600 << "h";
+    }
+    else if (3600 <= total)
+    {
+        text << total / 3600 << "h " << (total % 3600) / 60 << "m";
+    }
+    else
+    {
+        text << total / 60 << "m " << total % 60 << "s";
+    }
+    return text.str();
+}
+
+/* Rough single thread seconds for classic inference over every window, or a negative
+    value if the PRNG can't make the predictions classic inference scores windows by */
+double EstimateClassicCost(PRNG *generator)
+{
+    uint32_t stateSize = generator->getStateSize();
+    uint32_t windows = observedOutputs.size() - stateSize;
+    uint32_t probe = 0;
+    generator->setState(OutputSpan(observedOutputs).subspan(0, stateSize));
+    if (generator->predictForward(&probe, 1) == 0)
+    {
+        return -1.0;
     }
 
-    delete status;
+    std::vector<uint32_t> predictions(observedOutputs.size());
+    uint32_t samples = std::min(windows, CALIBRATION_WINDOWS);
+    steady_clock::time_point start = steady_clock::now();
+    for (uint32_t window = 0; window < samples; ++window)
+    {
+        ScoreWindow(generator, window, predictions);
+    }
+    double elapsed = std::chrono::duration<double>(steady_clock::now() - start).count();
+    return elapsed / samples * windows;
 }
 
-void FindSeed(const std::string& rng, unsigned int threads, double miniumConfidence, uint32_t lowerBoundSeed,
-        uint32_t upperBoundSeed, uint32_t depth)
+/* Rough single thread seconds for the sliding pass, timed on the first segment */
+double EstimateSlidingCost(PRNG *generator)
 {
-    std::cout << INFO << "Brute Forcing for seed using " << rng << std::endl;
+    uint32_t stateSize = generator->getStateSize();
+    uint32_t relations = observedOutputs.size() - stateSize;
+    uint32_t samples = std::min(relations, SLIDING_SEGMENT_SIZE);
+    std::vector<uint32_t> runs(observedOutputs.size() + 1, 0);
 
-    /* Each thread needs their own set of answers to avoid locking */
-    std::vector<std::vector<Seed>* > *answers = new std::vector<std::vector<Seed>* >(threads);
-    steady_clock::time_point elapsed = steady_clock::now();
-    SpawnThreads(threads, answers, miniumConfidence, lowerBoundSeed, upperBoundSeed, depth, rng);
+    steady_clock::time_point start = steady_clock::now();
+    SlideSegment(generator, 0, samples, &runs);
+    double elapsed = std::chrono::duration<double>(steady_clock::now() - start).count();
+    return elapsed / samples * relations;
+}
 
-    std::cout << INFO << "Completed in " << duration_cast<seconds>(steady_clock::now() - elapsed).count()
-              << " second(s)" << std::endl;
+/*
+    Decide what to run and say what it should cost. Each piece is timed on a
+    small sample (a few inference windows, one sliding segment, a handful of
+    seeds per search kernel) and scaled up to the observed values, the seed
+    range and the depth:
+     - state inference per PRNG, classic unless that can't predict this PRNG or
+       would take over INFERENCE_SECONDS, sliding window otherwise
+     - iterative deepening when a full depth brute force would take over
+       DEEPENING_SECONDS and there's room for shallower tiers
+     - a race between the two, or whichever one is possible
+     - the number of threads, unless -t was given: up to every thread there
+       is, but no more than leaves each one CHUNK_SECONDS of work, or (for
+       inference alone) a window or segment to work on
+    Anything given on the command line (-m, -s, -e, -t) is kept as is.
+*/
+SearchPlan MakePlan(const std::vector<std::string>& rngs, const std::vector<bool>& inferable, const std::string& variant,
+        unsigned int threads, bool isThreadCountGiven, uint64_t seedCount, uint32_t depth, const std::string& strategy,
+        bool isSliding, bool isDeepening)
+{
+    TraceSpan span("plan", "setup");
+    SearchPlan plan;
+    plan.strategy = strategy;
+    plan.threads = threads;
+    plan.isPinned = false;
+    plan.isDeepening = isDeepening;
+    plan.inferenceSeconds = 0.0;
+    plan.searchSeconds = 0.0;
 
-    /* Display results */
-    for (unsigned int id = 0; id < answers->size(); ++id)
+    /* Single thread costs first, so they can size the thread count */
+    PRNGFactory factory;
+    std::vector<double> inferenceCosts;
+    uint64_t inferenceUnits = 0;
+    for (unsigned int index = 0; index < rngs.size() && strategy != "brute"; ++index)
     {
-        /* Look for answers from each thread */
-        for (unsigned int index = 0; index < answers->at(id)->size(); ++index)
+        PRNG *generator = factory.getInstance(rngs[index]);
+        uint32_t stateSize = generator->getStateSize();
+        if (inferable[index] && stateSize < observedOutputs.size())
         {
-            std::cout << SUCCESS << "Found seed " << answers->at(id)->at(index).first
-                      << " with a confidence of " << answers->at(id)->at(index).second
-                      << '%' << std::endl;
+            generator->setEvidence(observedOutputs);
+            double classicCost = isSliding ? -1.0 : EstimateClassicCost(generator);
+            bool isSlidingEngine = (classicCost < 0.0 || INFERENCE_SECONDS * threads < classicCost);
+            uint32_t relations = observedOutputs.size() - stateSize;
+
+            plan.inferred.push_back(rngs[index]);
+            plan.sliding.push_back(isSlidingEngine);
+            inferenceCosts.push_back(isSlidingEngine ? EstimateSlidingCost(generator) : classicCost);
+            plan.inferenceSeconds += inferenceCosts.back();
+            inferenceUnits += isSlidingEngine ? (relations + SLIDING_SEGMENT_SIZE - 1) / SLIDING_SEGMENT_SIZE : relations;
         }
-        delete answers->at(id);
+        delete generator;
     }
-    delete answers;
-}
 
-/* 
-    This is the "smarter" method of breaking RNGs. We use consecutive integers
-    to infer information about the internal state of the RNG. Using this 
-    method, however, we won't typically recover an actual seed value. 
-    But the effect is the same.
-*/
-bool InferState(const std::string& rng)
-{
-    std::cout << INFO << "Trying state inference" << std::endl;
+    double seedCost = 0.0;
+    for (unsigned int index = 0; index < rngs.size() && strategy != "infer"; ++index)
+    {
+        seedCost += EstimateSeedCost(rngs[index], variant, depth);
+    }
+    double fullDepthSeconds = seedCost * seedCount;
 
-    PRNGFactory factory;
-    PRNG *generator = factory.getInstance(rng);
-    uint32_t stateSize = generator->getStateSize();
+    if (!isThreadCountGiven)
+    {
+        double work = plan.inferenceSeconds + fullDepthSeconds;
+        uint64_t useful = (uint64_t) std::ceil(work / CHUNK_SECONDS);
+        if (strategy == "infer" || fullDepthSeconds == 0.0)
+        {
+            useful = std::min(useful, inferenceUnits);
+        }
+        plan.threads = (unsigned int) std::max((uint64_t) 1, std::min(useful, (uint64_t) threads));
+    }
+    plan.inferenceSeconds /= plan.threads;
+    fullDepthSeconds /= plan.threads;
+    for (unsigned int index = 0; index < plan.inferred.size(); ++index)
+    {
+        std::cout << DEBUG << "Plan: " << (plan.sliding[index] ? "sliding window" : "classic") << " state inference on "
+                  << plan.inferred[index] << ", " << FormatSeconds(inferenceCosts[index] / plan.threads) << std::endl;
+    }
 
-    if(observedOutputs.size() <= stateSize)
+    if (strategy == "auto" && !isDeepening && DEEPENING_SECONDS < fullDepthSeconds)
     {
-        std::cout << WARN << "Not enough observed values to perform state inference." << std::endl;
-        std::cout << WARN << "Try again with more than " << stateSize << " values" << std::endl;
-        return false;
+        plan.isDeepening = (1 < DepthTiers(depth, true).size());
     }
 
-    double highscore = 0.0;
+    /* A seed costs roughly its depth, so the shallower tiers scale down from the full one */
+    std::vector<uint32_t> tiers = DepthTiers(depth, plan.isDeepening);
+    for (unsigned int index = 0; index < tiers.size() && strategy != "infer"; ++index)
+    {
+        plan.searchSeconds += fullDepthSeconds * tiers[index] / depth;
+    }
 
-    /* Guaranteed from the above to loop at least one time */
-    std::vector<double> scores;
-    std::vector<uint32_t> best_state;
-    for(uint32_t i = 0; i < (observedOutputs.size() - stateSize); i++)
+    if (plan.strategy == "auto")
     {
-        std::vector<uint32_t>::const_iterator first = observedOutputs.begin() + i;
-        std::vector<uint32_t>::const_iterator last = observedOutputs.begin() + i + stateSize;
-        std::vector<uint32_t> state(first, last);
+        plan.strategy = plan.inferred.empty() ? "brute" : "race";
+    }
+    if (plan.strategy == "infer" && plan.inferred.empty())
+    {
+        std::cout << WARN << "No state can be inferred (too few observed values, or none fit), brute forcing instead" << std::endl;
+        return MakePlan(rngs, inferable, variant, threads, isThreadCountGiven, seedCount, depth, "brute", isSliding,
+                        isDeepening);
+    }
 
-        /* Make predictions based on the state */
-        std::vector<uint32_t> evidenceForward
-            ((std::vector<uint32_t>::const_iterator)observedOutputs.begin(), first);
-        std::vector<uint32_t> evidenceBackward
-            (last+1, (std::vector<uint32_t>::const_iterator)observedOutputs.end());
-        generator->setState(state);
+    std::cout << INFO << "Plan, with rough times: ";
+    if (plan.strategy != "brute")
+    {
+        std::cout << "state inference (" << FormatSeconds(plan.inferenceSeconds) << ")";
+    }
+    if (plan.strategy == "race")
+    {
+        std::cout << " racing ";
+    }
+    if (plan.strategy != "infer")
+    {
+        std::cout << "brute force of " << seedCount << " seed(s)" << (plan.isDeepening ? " with iterative deepening" : "")
+                  << " (" << FormatSeconds(plan.searchSeconds) << ")";
+    }
+    std::cout << " on " << plan.threads;
+    if (plan.threads < threads)
+    {
+        std::cout << " of " << threads;
+    }
+    std::cout << " thread(s)" << std::endl;
+    return plan;
+}
 
-        /* Provide additional evidence for tuning on PRNGs that require it */
-        generator->setEvidence(observedOutputs);
-        generator->tune(evidenceForward, evidenceBackward);
+/* Race state inference (for the PRNGs it applies to) against brute force for every PRNG */
+void FindSeed(const std::vector<std::string>& rngs, const std::string& variant, const SearchPlan& plan,
+        double miniumConfidence, uint32_t lowerBoundSeed, uint32_t upperBoundSeed, uint32_t depth,
+        const std::vector<uint32_t>& hints, const SearchBudget& budget, const TelemetryOptions& telemetryOptions,
+        const ResultOptions& resultOptions)
+{
+    unsigned int threads = plan.threads;
+    Telemetry telemetry(threads, rngs.size());
+    Topology topology;
+    SearchJob search;
+    search.topology = plan.isPinned ? &topology : NULL;
+    search.replicas.resize(topology.nodeCount());
+    search.telemetry = &telemetry;
+    search.isCountingCycles = telemetryOptions.isCountingCycles;
+    if (search.isCountingCycles && !PerfCounters().isOpen())
+    {
+        std::cerr << WARN << "Cannot open perf counters (see /proc/sys/kernel/perf_event_paranoid), "
+                  << "carrying on without cycle counts" << std::endl;
+        search.isCountingCycles = false;
+    }
+    search.hasDeadline = (0.0 < budget.seconds);
+    search.deadline = steady_clock::now() + duration_cast<steady_clock::duration>(std::chrono::duration<double>(budget.seconds));
+    search.stepBudget = budget.steps;
+    search.stepsUsed = 0;
 
-        std::vector<uint32_t> predictions_forward = 
-            generator->predictForward(((observedOutputs.size() - stateSize) - i));
-        std::vector<uint32_t> predictions_backward = 
-            generator->predictBackward(i);
+    InferenceJob inference;
+    PrepareInference(&inference, plan.inferred, plan.sliding);
 
-        /* Test the prediction against the rest of the observed data */
-        /* Forward */
-        uint32_t matchesFound = 0;
-        uint32_t index_pred = 0;
-        uint32_t index_obs = i + stateSize;
-        while(index_obs < observedOutputs.size() && index_pred < predictions_forward.size())
+    search.rngs = rngs;
+    search.variant = variant;
+    search.lowerBoundSeed = lowerBoundSeed;
+    search.seedCount = (plan.strategy == "infer") ? 0 : (uint64_t) upperBoundSeed - lowerBoundSeed + 1;
+    search.minimumConfidence = miniumConfidence;
+    search.hints = hints;
+    search.resultLimit = resultOptions.limit;
+    search.stream = resultOptions.stream;
+    SeedSpill spill;
+    search.spill = NULL;
+    if (!resultOptions.spillPath.empty())
+    {
+        if (!spill.open(resultOptions.spillPath))
         {
-            if(observedOutputs[index_obs] == predictions_forward[index_pred])
-            {
-                matchesFound++;
-                index_obs++;
-            }
-            index_pred++;
+            std::cerr << WARN << "Could not open \"" << resultOptions.spillPath << "\" to spill seeds to, "
+                      << "carrying on without it" << std::endl;
         }
-
-        /* Backward */
-        index_pred = 0;
-        index_obs = i;
-        while(index_obs > 0 && index_pred < predictions_backward.size())
+        else
         {
-            if(observedOutputs[index_obs] == predictions_backward[index_pred])
-            {
-                matchesFound++;
-                index_obs--;
-            }
-            index_pred++;
+            search.spill = &spill;
         }
+    }
 
-        /* If we get a perfect guess, then try reversing out the seed, and exit */
-        if(matchesFound == (observedOutputs.size() - stateSize))
+    /* A fast kernel that disagrees with its PRNG's class could miss the seed, so fall back to scalar */
+    PRNGFactory factory;
+    for (unsigned int index = 0; index < rngs.size() && 0 < search.seedCount; ++index)
+    {
+        if (!factory.checkKernel(rngs[index], search.variant))
         {
-            uint32_t outSeed = 0;
-            if(generator->reverseToSeed(&outSeed, 10000))
-            {
-                /* We win! */
-                std::cout << SUCCESS << "Found seed " << outSeed << std::endl;
-            }
-            else
-            {
-                std::cout << SUCCESS << "Found state: " << std::endl;
-                std::vector<uint32_t> state = generator->getState();
-                for(uint32_t j = 0; j < state.size(); j++)
-                {
-                    std::cout << SUCCESS << state[j] << std::endl;
-                }
-            }
-            return true;
+            std::cerr << WARN << "The " << factory.getKernel(rngs[index], search.variant).name << " kernel for "
+                      << rngs[index] << " failed its self-check, using the scalar kernels" << std::endl;
+            search.variant = "scalar";
         }
+    }
+    for (unsigned int index = 0; index < rngs.size() && 0 < search.seedCount; ++index)
+    {
+        std::cout << INFO << "Brute Forcing for seed using " << rngs[index] << " ("
+                  << factory.getKernel(rngs[index], search.variant).name << " kernel)" << std::endl;
+    }
+
+    std::vector<InferenceWorkspace> workspaces(threads);
+    steady_clock::time_point elapsed = steady_clock::now();
+    SpawnThreads(threads, &search, DepthTiers(depth, plan.isDeepening), &inference, &workspaces);
+    double runSeconds = std::chrono::duration<double>(steady_clock::now() - elapsed).count();
+    if (search.stream != NULL)
+    {
+        search.stream->done(telemetry.totals().seeds, IsOverBudget(&search));
+    }
 
-        double score = (double)(matchesFound*100) / (double)(observedOutputs.size() - stateSize);
-        scores.push_back(score);
-        if(score > highscore)
+    std::cout << INFO << "Completed in " << (int) runSeconds << " second(s)" << std::endl;
+    if (!telemetryOptions.metricsPath.empty())
+    {
+        std::ofstream metrics(telemetryOptions.metricsPath.c_str());
+        telemetry.writeJson(metrics, search.rngs, runSeconds);
+        if (!metrics)
         {
-            best_state = generator->getState();
+            std::cerr << WARN << "Could not write metrics to \"" << telemetryOptions.metricsPath << "\"" << std::endl;
         }
     }
 
-    /* Analyze scores */
-    //TODO
-    if(highscore > 0)
+    /* Display results, a seed that passed at several depth tiers only once with its best confidence */
+    if (0 < search.seedCount && IsOverBudget(&search))
     {
-        std::cout << SUCCESS << "Best state guess, with confidence of: " << highscore << "%" << std::endl;
-        std::vector<uint32_t> state = generator->getState();
-        for(uint32_t j = 0; j < state.size(); j++)
+        ReportCoverage(&search);
+    }
+    ReportInference(&inference, workspaces, search.isFound);
+    TopSeeds top(resultOptions.limit);
+    for (unsigned int id = 0; id < search.results.size(); ++id)
+    {
+        top.merge(search.results[id]);
+    }
+    std::vector<Seed> kept = top.sorted();
+    if (kept.size() < top.offered())
+    {
+        std::cout << WARN << "Only the " << kept.size() << " most confident of " << top.offered()
+                  << " seed(s) are shown, see -K and -S" << std::endl;
+    }
+    if (spill.isOpen())
+    {
+        uint64_t spilled = spill.count();
+        if (spill.close())
         {
-            std::cout << SUCCESS << state[j] << std::endl;
+            std::cout << INFO << "Spilled " << spilled << " record(s) to \"" << resultOptions.spillPath << "\"" << std::endl;
+        }
+        else
+        {
+            std::cerr << WARN << "Could not write every seed to \"" << resultOptions.spillPath << "\"" << std::endl;
         }
     }
-    else
+
+    for (unsigned int index = 0; index < kept.size(); ++index)
     {
-        std::cout << INFO << "State Inference failed" << std::endl;
+        std::cout << SUCCESS << "Found seed " << kept[index].value << " (" << search.rngs[kept[index].engine]
+                  << ") with a confidence of " << kept[index].confidence << '%' << std::endl;
     }
-
-    return false;
 }
 
 int main(int argc, char *argv[])
 {
     int c;
-    unsigned int threads = std::thread::hardware_concurrency();
+    Topology topology;
+    unsigned int threads = topology.defaultThreads();
+    bool isThreadCountGiven = false;
+    bool isPinned = false;
     uint32_t lowerBoundSeed = 0;
     uint32_t upperBoundSeed = UINT_MAX;
     uint32_t depth = 1000;
     uint32_t seed = 0;
     double minimumConfidence = 100.0;
+    double fingerprintConfidence = FINGERPRINT_CONFIDENCE;
+    bool isForced = false;
+    bool isSliding = false;
+    bool isDeepening = false;
+    std::vector<uint32_t> hints;
+    std::string strategy = "auto";
+    SearchBudget budget = {0.0, 0};
+    TelemetryOptions telemetryOptions = {false, ""};
+    ResultOptions resultOptions = {1000, "", NULL};
+    std::string streamPath;
+    std::string inputPath;
+    InputFormat inputFormat = {0, false};
+    std::string tracePath;
+    std::string variant;
     PRNGFactory factory;
-    std::string rng = factory.getNames()[0];
+    std::vector<std::string> rngs(1, factory.getNames()[0]);
 
-    while ((c = getopt(argc, argv, "d:i:g:t:r:c:uh")) != -1)
+    while ((c = getopt(argc, argv, "d:i:g:t:r:c:q:k:n:l:b:m:j:x:a:K:S:o:F:ufsepwh")) != -1)
     {
         switch (c)
         {
@@ -377,13 +1779,41 @@ int main(int argc, char *argv[])
                 upperBoundSeed = time(NULL) + ONE_YEAR;
                 break;
             }
+            case 'a':
+            {
+                char *end = NULL;
+                unsigned long long lower = strtoull(optarg, &end, 10);
+                unsigned long long upper = (*end == ':') ? strtoull(end + 1, &end, 10) : 0;
+                if (*end != '\0' || upper < lower || UINT_MAX < upper)
+                {
+                    std::cerr << WARN << "ERROR: Please enter a seed range as <lower>:<upper>, within 0:" << UINT_MAX << std::endl;
+                    return EXIT_FAILURE;
+                }
+                lowerBoundSeed = lower;
+                upperBoundSeed = upper;
+                break;
+            }
             case 'r':
             {
-                rng = optarg;
+                rngs.clear();
                 std::vector<std::string> names = factory.getNames();
-                if (std::find(names.begin(), names.end(), rng) == names.end())
+                std::stringstream list(optarg);
+                std::string rng;
+                while (std::getline(list, rng, ','))
                 {
-                    std::cerr << WARN << "ERROR: The PRNG \"" << optarg << "\" is not supported, see -h" << std::endl;
+                    if (std::find(names.begin(), names.end(), rng) == names.end())
+                    {
+                        std::cerr << WARN << "ERROR: The PRNG \"" << rng << "\" is not supported, see -h" << std::endl;
+                        return EXIT_FAILURE;
+                    }
+                    if (std::find(rngs.begin(), rngs.end(), rng) == rngs.end())
+                    {
+                        rngs.push_back(rng);
+                    }
+                }
+                if (rngs.empty())
+                {
+                    std::cerr << WARN << "ERROR: Please name at least one PRNG, see -h" << std::endl;
                     return EXIT_FAILURE;
                 }
                 break;
@@ -400,15 +1830,15 @@ int main(int argc, char *argv[])
             }
             case 'i':
             {
-                std::ifstream infile(optarg);
-                if (!infile)
-                {
-                    std::cerr << WARN << "ERROR: File \"" << optarg << "\" not found" << std::endl;
-                }
-                std::string line;
-                while (std::getline(infile, line))
+                inputPath = optarg;
+                break;
+            }
+            case 'F':
+            {
+                if (!ObservationLoader::parseFormat(optarg, &inputFormat))
                 {
-                    observedOutputs.push_back(strtoul(line.c_str(), NULL, 10));
+                    std::cerr << WARN << "ERROR: The input format \"" << optarg << "\" does not exist, see -h" << std::endl;
+                    return EXIT_FAILURE;
                 }
                 break;
             }
@@ -420,6 +1850,7 @@ int main(int argc, char *argv[])
                     std::cerr << WARN << "ERROR: Please enter a valid number of threads > 1" << std::endl;
                     return EXIT_FAILURE;
                 }
+                isThreadCountGiven = true;
                 break;
             }
             case 'c':
@@ -432,6 +1863,127 @@ int main(int argc, char *argv[])
                 }
                 break;
             }
+            case 'k':
+            {
+                variant = optarg;
+                std::vector<std::string> variants = factory.getVariantNames();
+                if (std::find(variants.begin(), variants.end(), variant) == variants.end())
+                {
+                    std::cerr << WARN << "ERROR: The kernel \"" << variant << "\" does not exist, see -h" << std::endl;
+                    return EXIT_FAILURE;
+                }
+                if (!PRNGFactory::isVariantSupported(variant))
+                {
+                    std::cerr << WARN << "ERROR: This CPU cannot run the \"" << variant << "\" kernel" << std::endl;
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'q':
+            {
+                fingerprintConfidence = ::atof(optarg);
+                if (fingerprintConfidence < 0 || 100.0 < fingerprintConfidence)
+                {
+                    std::cerr << WARN << "ERROR: Invalid fingerprint percentage " << std::endl;
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'f':
+            {
+                isForced = true;
+                break;
+            }
+            case 's':
+            {
+                isSliding = true;
+                break;
+            }
+            case 'e':
+            {
+                isDeepening = true;
+                break;
+            }
+            case 'm':
+            {
+                strategy = optarg;
+                if (strategy != "auto" && strategy != "race" && strategy != "infer" && strategy != "brute")
+                {
+                    std::cerr << WARN << "ERROR: The strategy \"" << strategy << "\" does not exist, see -h" << std::endl;
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'l':
+            {
+                budget.seconds = ::atof(optarg);
+                if (budget.seconds <= 0)
+                {
+                    std::cerr << WARN << "ERROR: Please enter a time limit in seconds > 0" << std::endl;
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'b':
+            {
+                budget.steps = strtoull(optarg, NULL, 10);
+                if (budget.steps == 0)
+                {
+                    std::cerr << WARN << "ERROR: Please enter a step budget > 0" << std::endl;
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'p':
+            {
+                telemetryOptions.isCountingCycles = true;
+                break;
+            }
+            case 'j':
+            {
+                telemetryOptions.metricsPath = optarg;
+                break;
+            }
+            case 'w':
+            {
+                isPinned = true;
+                break;
+            }
+            case 'x':
+            {
+                tracePath = optarg;
+                break;
+            }
+            case 'K':
+            {
+                resultOptions.limit = strtoull(optarg, NULL, 10);
+                if (resultOptions.limit == 0)
+                {
+                    std::cerr << WARN << "ERROR: Please keep at least 1 seed" << std::endl;
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'S':
+            {
+                resultOptions.spillPath = optarg;
+                break;
+            }
+            case 'o':
+            {
+                streamPath = optarg;
+                break;
+            }
+            case 'n':
+            {
+                std::stringstream list(optarg);
+                std::string hint;
+                while (std::getline(list, hint, ','))
+                {
+                    hints.push_back(strtoul(hint.c_str(), NULL, 10));
+                }
+                break;
+            }
             case 'h':
             {
                 Usage(factory, threads);
@@ -458,10 +2010,21 @@ int main(int argc, char *argv[])
 
     if (seed != 0)
     {
-        GenerateSample(seed, depth, rng);
+        GenerateSample(seed, depth, rngs[0]);
         return EXIT_SUCCESS;
     }
 
+    if (!inputPath.empty())
+    {
+        ObservationLoader loader(inputFormat);
+        if (!loader.load(inputPath, &observedOutputs))
+        {
+            std::string name = (inputPath == "-") ? "stdin" : "\"" + inputPath + "\"";
+            std::cerr << WARN << "ERROR: Cannot load " << name << ", " << loader.error() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     if (observedOutputs.empty())
     {
         Usage(factory, threads);
@@ -469,12 +2032,66 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
-    if(InferState(rng))
+    if (!tracePath.empty())
     {
-        return EXIT_SUCCESS;
+        Trace::enable();
+        Trace::nameThread("main");
+    }
+
+    /* With the result stream on stdout, everything meant for people goes to stderr instead */
+    ResultStream stream;
+    std::streambuf *stdoutBuffer = std::cout.rdbuf();
+    if (streamPath == "-")
+    {
+        stream.attach(stdoutBuffer);
+        std::cout.rdbuf(std::cerr.rdbuf());
+    }
+    else if (!streamPath.empty() && !stream.open(streamPath))
+    {
+        std::cerr << WARN << "ERROR: Could not open \"" << streamPath << "\" to stream results to" << std::endl;
+        return EXIT_FAILURE;
+    }
+    resultOptions.stream = stream.isOpen() ? &stream : NULL;
+
+    /* A PRNG the fingerprint rules out is still brute forced, but only has its state inferred with -f */
+    std::vector<EngineFit> fits = DetectEngines(fingerprintConfidence);
+    std::vector<bool> inferable;
+    bool isAnyPlausible = false;
+    for (unsigned int index = 0; index < rngs.size(); ++index)
+    {
+        std::string rng = rngs[index];
+        EngineFit fit = *std::find_if(fits.begin(), fits.end(), [&rng](const EngineFit& each) {
+            return each.name == rng;
+        });
+        inferable.push_back(fit.isPlausible || isForced);
+        isAnyPlausible = isAnyPlausible || fit.isPlausible;
+        if (!fit.isPlausible)
+        {
+            std::cerr << WARN << "The observed values do not look like consecutive " << rng << " output" << std::endl;
+        }
+    }
+    for (unsigned int index = 0; index < fits.size() && !isAnyPlausible; ++index)
+    {
+        if (fits[index].isPlausible && fits[index].isTested)
+        {
+            std::cerr << WARN << "Consider -r " << fits[index].name << std::endl;
+        }
     }
 
-    FindSeed(rng, threads, minimumConfidence, lowerBoundSeed, upperBoundSeed, depth);
+    SearchPlan plan = MakePlan(rngs, inferable, variant, threads, isThreadCountGiven,
+                               (uint64_t) upperBoundSeed - lowerBoundSeed + 1, depth, strategy, isSliding, isDeepening);
+    plan.isPinned = isPinned;
+    FindSeed(rngs, variant, plan, minimumConfidence, lowerBoundSeed, upperBoundSeed, depth, hints, budget, telemetryOptions,
+             resultOptions);
+    if (!tracePath.empty() && !Trace::write(tracePath))
+    {
+        std::cerr << WARN << "Could not write the trace to \"" << tracePath << "\"" << std::endl;
+    }
+    if (!stream.close())
+    {
+        std::cerr << WARN << "Could not write every result to \"" << streamPath << "\"" << std::endl;
+    }
+    std::cout.rdbuf(stdoutBuffer);
     return EXIT_SUCCESS;
 }
 